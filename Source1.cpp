@@ -4,12 +4,21 @@
 #include <time.h>       
 #include <cmath>        
 #include <cstdio>
+#include <algorithm>    // sort for latency percentiles
+#include <cstring>      // memcpy for snapshots
+#include "net_socket.h" // udp for the two player mode
+#include <coroutine>    // level and enemy scripts, needs /std:c++20
+#include <new>          // placement new for the level arena
+#ifdef SOAK_TEST
+#include <chrono>       // tick timing for the soak test
+#include <climits>
+#include "soak_stats.h"
+#endif
 using namespace std;
 
 //game constants
 const int SCREEN_WIDTH = 1280;   
 const int SCREEN_HEIGHT = 800;   
-const int MAX_UFOS = 50;         
 const int MAX_SHOTS = 20;
 const int MAX_SPARKS = 100;
 const int NUM_WALLS = 4;
@@ -21,6 +30,7 @@ const int UFO_W = 60;
 const int UFO_H = 40;
 const int SHOT_W = 16;
 const int SHOT_H = 32;
+const int UFO_SPACING_X = UFO_W + 40; //distance between two ufo columns
 
 // speeds and time
 const float BASE_UFO_TIME = 0.05f;
@@ -29,6 +39,16 @@ const float UFO_Y_DROP = 20.0f;
 const float SHIP_MOVE_SPEED = 8.0f;
 const float SHIP_FIRE_DELAY = 0.2f;
 const float TRIPLE_SHOT_DELAY = 1.5f;
+const float BASE_UFO_FIRE_INTERVAL = 1.0f;
+const bool AIMED_FIRE_ENABLED = false;       //true makes some ufo shots aim at the player, harder than the original game
+const int AIMED_FIRE_PERCENT_PER_LEVEL = 15; //chance an ufo shot is aimed grows each level
+const int MAX_AIMED_FIRE_PERCENT = 60;
+
+// ship input bits, the client sends these to the host
+const unsigned char INPUT_LEFT = 1;
+const unsigned char INPUT_RIGHT = 2;
+const unsigned char INPUT_FIRE = 4;
+const unsigned char INPUT_TRIPLE = 8;
 
 
 //level transitions 
@@ -36,6 +56,49 @@ const float FADE_TIME = 0.5f;
 const float HOLD_TIME = 1.5f;
 const float TOTAL_TRANSITION_TIME = FADE_TIME * 2 + HOLD_TIME;
 
+//wave scripting
+const int SCRIPT_POOL_SIZE = 4096;      //max scripts running at once
+const int SCRIPT_FRAME_SIZE = 512;      //bytes reserved per coroutine frame
+//the arena has no size limit, waves only stop growing where they stop fitting on screen
+const int WAVE_MARCH_ROOM = 200;        //the widest wave can still march this far sideways
+const int MAX_WAVE_COLS = (SCREEN_WIDTH - WAVE_MARCH_ROOM + 40) / UFO_SPACING_X;
+const int MAX_WAVE_ROWS = (SCREEN_HEIGHT * 3 / 5 - 50) / (UFO_H + 20); //starts in the top 60% of the screen
+const float UFO_ENTRY_TIME = 1.2f;      //how long one ufo takes to fly into its slot
+const float UFO_ENTRY_STAGGER = 0.04f;  //delay between ufos starting to fly in
+const float UFO_ENTRY_SWING = 150.0f;   //sideways curve of the entry path
+const float FORMATION_CHANGE_TIME = 8.0f;   //seconds of marching between formation changes
+const float FORMATION_BLEND_TIME = 1.0f;    //how long the ufos take to slide into a new shape
+const float FORMATION_V_STEP = 12.0f;       //each column nearer the middle sits this much lower in the V
+const float FORMATION_WAVE_HEIGHT = 15.0f;  //up and down swing of the wave shape
+
+//low latency frame pacing
+const int TARGET_FPS = 60;
+const double TARGET_FRAME_TIME = 1.0 / TARGET_FPS;
+const double PACING_SAFETY_MARGIN = 0.001; //wake up a bit before the predicted deadline
+const double PACING_SPIN_TIME = 0.002;     //os sleep is coarse so low latency mode busy waits the last part
+const int LATENCY_SAMPLES = 240;           //about 4 seconds of frames
+const int PAUSED_FPS = 10;                 //nothing moves but the stars while paused
+
+//two player networking
+const unsigned short NET_DEFAULT_PORT = 27960;
+const int NET_SNAPSHOT_INTERVAL = 2;   //host sends the state every 2nd tick
+const int NET_SNAPSHOT_HISTORY = 32;   //snapshots kept around as delta baselines
+const int NET_MAX_PACKET = 1200;       //stay under a normal MTU
+const int NET_MAX_SNAPSHOT = NET_MAX_PACKET; //raw quantized state before delta compression, the wave cap keeps it below this
+const int NET_SNAPSHOT_HEADER = 11;    //packet type, id, baseline id, raw size
+const int NET_SNAPSHOT_BASE = 31 + 2 * ((MAX_SHOTS + 7) / 8) + 4 * MAX_SHOTS + NUM_WALLS; //snapshot bytes apart from the ufos
+//delta encoding can grow a snapshot to 1.5x when every other byte changes (ufos flying in),
+//so a network wave is capped to what still fits one packet then, 4 bytes and a bit per ufo
+const int NET_MAX_WAVE_UFOS = ((NET_MAX_PACKET - NET_SNAPSHOT_HEADER) / 3 * 2 - 2 - NET_SNAPSHOT_BASE - 1) * 8 / 33;
+const int NET_INPUT_HISTORY = 64;      //client inputs kept for prediction replay
+const int NET_INPUT_REDUNDANCY = 4;    //each input packet repeats the last few inputs in case of loss
+const int NET_MAX_QUEUED_INPUTS = 8;   //host drops older inputs if the client runs ahead
+const int NET_PARTNER_TIMEOUT = 3 * TARGET_FPS; //ticks without a valid input before the host drops the partner
+const int NET_UDP_OVERHEAD = 28;       //ip + udp header, counted in the bandwidth numbers
+const float NET_POS_SCALE = 4.0f;      //positions are sent in quarter pixels
+const unsigned char NET_PACKET_SNAPSHOT = 1;
+const unsigned char NET_PACKET_INPUT = 2;
+
 //structd
 
 struct GamerShip { 
@@ -70,6 +133,95 @@ struct Spark {
     bool isVisible = false;
 };
 
+//timestamps of one frame, used to measure input lag
+struct FrameTiming {
+    double inputTime;   //when input was sampled
+    double simEndTime;  //when the game logic finished
+    double submitTime;  //when the frame was ready to swap
+    double presentTime; //when the frame was handed to the screen
+};
+
+// bump allocator for everything that only lives for one wave, reset as a whole by the next one
+struct LevelArena {
+    unsigned char* memory = nullptr;
+    size_t capacity = 0;
+    size_t used = 0;
+    int heapBlocks = 0;     //times it went to the heap, the soak test watches this
+    size_t peakNeeded = 0;  //biggest wave asked for so far, growing only makes sense when this goes up
+};
+
+// coroutine frames come from a fixed pool, so scripts never touch the heap
+void* ScriptPoolAlloc(size_t size);
+void ScriptPoolFree(void* block);
+
+// a level or enemy script, written as a coroutine and resumed by RunScripts every tick
+struct ScriptTask {
+    struct promise_type {
+        float wakeTime = 0.0f; //script time when it wants to run again
+
+        ScriptTask get_return_object() { return { std::coroutine_handle<promise_type>::from_promise(*this) }; }
+        static ScriptTask get_return_object_on_allocation_failure() { return {}; } //pool is full
+        std::suspend_never initial_suspend() noexcept { return {}; } //run up to the first wait right away
+        std::suspend_always final_suspend() noexcept { return {}; }  //RunScripts cleans it up
+        void return_void() {}
+        void unhandled_exception() { terminate(); }
+        static void* operator new(size_t size) noexcept { return ScriptPoolAlloc(size); }
+        static void operator delete(void* block) { ScriptPoolFree(block); }
+    };
+    std::coroutine_handle<promise_type> handle;
+};
+typedef std::coroutine_handle<ScriptTask::promise_type> ScriptHandle;
+
+// co_await NextTick() waits for the next game tick
+struct NextTick {
+    bool await_ready() const { return false; }
+    void await_suspend(ScriptHandle h) const;
+    void await_resume() const {}
+};
+
+// co_await WaitSeconds(t) waits t seconds of game time, pauses dont count
+// always gives up at least the current tick, so a loop around it can never spin forever
+struct WaitSeconds {
+    float seconds;
+    bool await_ready() const { return false; }
+    void await_suspend(ScriptHandle h) const;
+    void await_resume() const {}
+};
+
+// one quantized game state, the host keeps the ones it sent, the client the ones it got
+struct NetSnapshot {
+    unsigned int id = 0; //0 means empty
+    int size = 0;
+    unsigned char data[NET_MAX_SNAPSHOT];
+};
+
+// input that reached the host but hasnt been applied yet
+struct PendingInput {
+    unsigned short seq;
+    unsigned char bits;
+};
+
+// byte packing helpers for packets and snapshots
+struct NetWriter {
+    unsigned char* data;
+    int capacity;
+    int size = 0;
+    bool overflow = false;
+};
+
+struct NetReader {
+    const unsigned char* data;
+    int size;
+    int pos = 0;
+    bool overflow = false;
+};
+
+struct LatencyStats {
+    float simP50, simP95, simP99;         //input -> simulation end (ms)
+    float presentP50, presentP95, presentP99; //input -> present (ms)
+    int sampleCount;
+};
+
 struct DefenseWall {
     Rectangle hitBox; //wall location and size 
     int hitPoints = 4;
@@ -79,32 +231,124 @@ struct DefenseWall {
 enum GameStatus {
     INTRO_MENU, HOW_TO_PLAY, IN_GAME, PAUSED_GAME, END_SCREEN, LEVEL_UP
 };
+
+//shapes the formation switches between while it marches, only the height of each column changes
+enum FormationShape {
+    FORMATION_FLAT, FORMATION_V, FORMATION_WAVE, NUM_FORMATIONS
+};
 //initialising global variables 
 GameStatus gameStatus = INTRO_MENU;
 int currentLevel = 1;
-float ufoMoveTimer = 0.0f;
 float ufoMoveDirection = 1.0f;
-float timeSinceLastUfoShot = 0.0f;
+Vector2 formationOffset = { 0.0f, 0.0f };   //how far the formation marched away from its slots
+FormationShape formationShape = FORMATION_FLAT;
+FormationShape formationLastShape = FORMATION_FLAT;
+float formationChangeTime = 0.0f;           //script time the current shape started blending in
 int highScore = 0;
 int currentUfosAlive = 10;
 int gridRows = 2;
 int gridCols = 5;
+int waveNumber = 0;    //bumped by StartWave, old enemy scripts stop when it changes
+int ufosEntering = 0;  //ufos still flying into the formation
 
 // Transition state trackers
 float levelTransitionTimer = 0.0f;
-bool levelResetExecuted = false;
 
+// script scheduler
+alignas(16) unsigned char scriptPool[SCRIPT_POOL_SIZE][SCRIPT_FRAME_SIZE];
+void* scriptFreeList = nullptr;
+bool scriptPoolReady = false;
+ScriptHandle scripts[SCRIPT_POOL_SIZE];
+int scriptCount = 0;
+float scriptTime = 0.0f; //game time seen by the scripts
+
+// frame pacing and latency tracking
+bool lowLatencyMode = false;
+bool showLatencyStats = false;
+double lastPresentTime = 0.0;
+double lastInputTime = 0.0;
+double nextPresentTime = 0.0;     //when the frame being made now reaches the screen
+bool vsyncPacing = false;         //the swap waits for the vblank, otherwise we hold the frame ourselves
+double frameWorkEstimate = 0.004; //smoothed time from input sample to swap submission
+FrameTiming frameTimings[LATENCY_SAMPLES];
+int frameTimingCount = 0;
+int frameTimingNext = 0;
+LatencyStats latencyStats = {};
+
+// keys pressed before the late input poll, so the poll doesnt swallow them
+const int TAP_KEYS[] = { KEY_ENTER, KEY_I, KEY_ESCAPE, KEY_P, KEY_SPACE, KEY_B, KEY_L, KEY_F1 };
+const int NUM_TAP_KEYS = sizeof(TAP_KEYS) / sizeof(TAP_KEYS[0]);
+bool latchedKeyTaps[NUM_TAP_KEYS];
+bool latchedMouseTap = false;
+
+// the soak test bot presses keys through these instead of the keyboard
+bool botInput = false;
+int botTappedKeys[4];
+int botTappedCount = 0;
+bool botHoldLeft = false;
+bool botHoldRight = false;
+bool scoreFileEnabled = true; //soak runs dont touch the real high score
+bool invasionEndsGame = true; //godmode soak runs turn this off so a game can last forever
+int startLevel = 1;           //soak runs can start games far in to reach huge levels quickly
+
+
+// two player mode
+enum NetRole {
+    NET_OFFLINE, NET_HOST, NET_CLIENT
+};
+NetRole netRole = NET_OFFLINE;
+bool partnerConnected = false;           //second ship is in the game
+NetSnapshot netHistory[NET_SNAPSHOT_HISTORY]; //host: sent snapshots, client: received ones
+unsigned int netSnapshotId = 0;          //host: last sent, client: newest received
+unsigned int netAckedId = 0;             //host: newest snapshot the client confirmed
+unsigned int netAppliedId = 0;           //client: snapshot currently shown
+PendingInput partnerInputs[NET_MAX_QUEUED_INPUTS];
+int partnerInputCount = 0;
+unsigned short partnerQueuedSeq = 0;     //newest input seq that reached the host
+unsigned short partnerAppliedSeq = 0;    //newest input seq the host simulated
+unsigned char partnerHeldInput = 0;      //keep moving if an input is late
+unsigned char clientInputHistory[NET_INPUT_HISTORY];
+unsigned short clientInputSeq = 0;
+int netTickCounter = 0;
+int partnerSilentTicks = 0;              //host: ticks since the last valid input packet
+int netSnapshotsDropped = 0;             //host: snapshots that didnt fit a packet, should stay 0
+
+// bandwidth counters, averaged over one second
+int netBytesOut = 0;
+int netBytesIn = 0;
+int netWindowTicks = 0;
+float netWindowTime = 0.0f;
+float netBytesOutPerTick = 0.0f;
+float netBytesInPerTick = 0.0f;
+float netKbOutPerSec = 0.0f;
+float netKbInPerSec = 0.0f;
 
 // the images we loaded
 Texture2D shipTexture, ufoTexture, playerShotTexture, ufoShotTexture;
 
+// menus, pause and game over are drawn once into this and reused until something changes
+RenderTexture2D idleScreenCache;
+bool idleCacheValid = false; //cleared on every non idle frame and whenever an idle screen changes
+GameStatus idleCacheStatus = INTRO_MENU;
+
 // Game Arrays
 GamerShip thePlayer;
+GamerShip thePartner; //second player in the networked mode, shares score and lives with thePlayer
 LaserShot allShots[MAX_SHOTS];
-Ufo allUfos[MAX_UFOS];
+Ufo* allUfos = nullptr; //gridRows * gridCols ufos in the level arena
+int ufoCount = 0;
 DefenseWall allWalls[NUM_WALLS];
 Spark allSparks[MAX_SPARKS];
 
+// front line of the formation, only these ufos are allowed to shoot (all in the level arena)
+int* columnFrontRow = nullptr;    // lowest live ufo row in each column, -1 when empty
+int* liveColumns = nullptr;       // packed list of columns that still have ufos
+int* liveColumnSlot = nullptr;    // position of each column in liveColumns, -1 if gone
+int liveColumnCount = 0;
+int* liveColumnTree = nullptr;    // fenwick tree over live columns for nearest column search
+
+LevelArena levelArena;
+
 
 //functions used
 void LoadScoreFile();
@@ -114,16 +358,38 @@ void LoadAllTextures();
 void UnloadAllTextures();
 void InitializeGame();
 void SetupUfos(int rows, int cols);
+void AllocateWaveStorage(int rows, int cols);
+void ResetLevelArena(size_t bytesNeeded);
+void* ArenaAlloc(size_t bytes, size_t align);
+void FreeLevelArena();
 void SetupWalls();
+void BuildColumnIndex();
+void RemoveUfoFromColumns(int index);
+void ColumnTreeAdd(int col, int delta);
+int ColumnTreeCount(int col);
+int ColumnTreeFind(int k);
+int NearestLiveColumn(int targetCol);
+int PickShooterColumn();
 void SetupSparks();
+void UpdateGameStatus(float frameTime);
 void UpdateEverything(float frameTime);
 void AdvanceLevel();
-void CheckIfLevelWon();
-void MoveShip(float frameTime);
+void SpawnScript(ScriptTask task);
+void RunScripts(float frameTime);
+void ResetScripts();
+ScriptTask LevelScript();
+ScriptTask UfoScript(int index, float delay);
+ScriptTask FormationScript();
+ScriptTask UfoFireScript();
+float FormationShapeY(FormationShape shape, int c, int cols);
+Vector2 FormationPosition(int r, int c);
+void MarchFormation();
+void StartWave(int rows, int cols);
+unsigned char ReadLocalInput();
+void HandleShipInput(GamerShip& ship, unsigned char input, float frameTime);
+void MoveShip(GamerShip& ship, unsigned char input);
 void FireShot(Rectangle sourceBox, bool isUfo, float offsetX);
-void FireTripleShot();
-void MoveUfos(float frameTime);
-void UfoShooting(float frameTime);
+void FireTripleShot(GamerShip& ship);
 void MoveShots(float frameTime);
 void CheckHits();
 void UpdateSparks(float frameTime);
@@ -134,8 +400,46 @@ void DrawHowToPlay();
 void DrawEndScreen();
 void DrawPauseScreen();
 void DrawLevelUpScreen();
+void DrawCurrentScreen();
+bool IsIdleScreen(GameStatus status);
+void RefreshIdleScreenCache();
+double CurrentFramePeriod();
+void StartFramePacing();
+void SetLowLatencyMode(bool enabled);
+void PlanNextPresent();
+void SleepUntil(double time, bool spin);
+void WaitForLateInput();
+void WaitForPresentSlot();
+void ClearLatchedTaps();
+bool KeyTapped(int key);
+bool MouseTapped(int button);
+bool KeyHeld(int key);
+void RecordFrameTiming(double inputTime, double simEndTime, double submitTime, double presentTime);
+void UpdateLatencyStats();
+void DrawLatencyStats();
+Vector2 UfoSlotPosition(int r, int c, int cols);
+void StartNetworkFromArgs(int argc, char** argv);
+void NetHostReceive();
+void DisconnectPartner();
+void NetHostUpdate();
+unsigned char NextPartnerInput();
+void NetClientUpdate();
+void ApplyClientSnapshot(const NetSnapshot& snap);
+int SnapshotSize(int ufos);
+int WriteSnapshot(unsigned char* out, int capacity);
+bool ReadSnapshot(const unsigned char* data, int size);
+int EncodeDelta(const unsigned char* current, int size, const unsigned char* baseline, int baselineSize, unsigned char* out, int capacity);
+int DecodeDelta(const unsigned char* encoded, int encodedSize, const unsigned char* baseline, int baselineSize, unsigned char* out, int outSize);
+const NetSnapshot* FindSnapshot(unsigned int id);
+void NetSend(const unsigned char* data, int size);
+void UpdateNetStats(float frameTime);
+void DrawNetStats();
+#ifdef SOAK_TEST
+int RunSoak(int argc, char** argv);
+#endif
 //saves the current highscore 
 void SaveScoreFile() {
+    if (!scoreFileEnabled) return;
     FILE* file = fopen("top_score.txt", "w");
     if (file) {
         fprintf(file, "%d", highScore); //write the no
@@ -180,133 +484,117 @@ void UnloadAllTextures() {
 
 
 // main function
-int main(void) {
+// start with -host [port] to wait for a second player, or -join address [port]
+int main(int argc, char** argv) {
+#ifdef SOAK_TEST
+    return RunSoak(argc, argv); //headless build, no window at all
+#endif
 
     // 1. Setup
     InitWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "Space Shooter - Survivors");
-    SetTargetFPS(60); // 60 frames per sec
+    StartFramePacing(); // 60 frames per sec, from vsync if the monitor runs at 60
     srand(static_cast<unsigned int>(time(NULL))); //initializing randomizer
 
     // loading
     LoadScoreFile();
     LoadAllTextures();
+    idleScreenCache = LoadRenderTexture(SCREEN_WIDTH, SCREEN_HEIGHT);
     SetupSparks();
     InitializeGame();
+    StartNetworkFromArgs(argc, argv);
+    lastPresentTime = GetTime();
+    lastInputTime = lastPresentTime;
+    nextPresentTime = lastPresentTime;
 
     // 2.Game Loop runs till user closes window
     while (!WindowShouldClose()) {
-        float frameTime = GetFrameTime(); //time passed since last screen update
+        //normal mode simulates right away with the keys EndDrawing read after the last present,
+        //low latency mode sleeps first and reads them again right before simulating
+        PlanNextPresent();
+        if (lowLatencyMode) {
+            WaitForLateInput();
+        }
+        double inputTime = GetTime();
 
-        UpdateSparks(frameTime); //background starry
+        //raylib doesnt know about our sleep, so measure between input samples
+        float frameTime = static_cast<float>(inputTime - lastInputTime);
+        lastInputTime = inputTime;
 
-        //depending on where we are menu,game etc corresponding action takes place
-        switch (gameStatus) {
-        case INTRO_MENU:
-            if (IsKeyPressed(KEY_ENTER)) {
-                InitializeGame();
-                gameStatus = IN_GAME;
-            }
-            else if (IsKeyPressed(KEY_I)) {
-                gameStatus = HOW_TO_PLAY;
-            }
-            break;
-        case HOW_TO_PLAY:
-            if (IsKeyPressed(KEY_ENTER) || IsKeyPressed(KEY_ESCAPE)) {
-                gameStatus = INTRO_MENU;
-            }
-            break;
-        case IN_GAME:
-            UpdateEverything(frameTime);
-            if (IsKeyPressed(KEY_P)) {
-                gameStatus = PAUSED_GAME;
-            }
-            break;
-        case PAUSED_GAME:
-            if (IsKeyPressed(KEY_P) || IsKeyPressed(KEY_ENTER)) {
-                gameStatus = IN_GAME;
-            }
-            break;
-        case LEVEL_UP: //for smooth transition between levels
-            levelTransitionTimer += frameTime; //increment the timer
+        if (KeyTapped(KEY_L)) {
+            SetLowLatencyMode(!lowLatencyMode);
+        }
+        if (KeyTapped(KEY_F1)) {
+            showLatencyStats = !showLatencyStats;
+        }
 
-            
-            if (levelTransitionTimer >= FADE_TIME && !levelResetExecuted) {
-                AdvanceLevel();
-                levelResetExecuted = true; //set flag so this only runs 
-            }
+        UpdateSparks(frameTime); //background starry
 
-            //transition time up then resume the game 
-            if (levelTransitionTimer >= TOTAL_TRANSITION_TIME) {
-                gameStatus = IN_GAME;
-                levelTransitionTimer = 0.0f;
-            }
-            break;
-        case END_SCREEN:
-            //check if current score is the new highscore
-            if (thePlayer.playerScore > highScore) {
-                highScore = thePlayer.playerScore;
-                SaveScoreFile();
-            }
-            if (IsKeyPressed(KEY_ENTER)) {
-                gameStatus = INTRO_MENU;
-            }
-            break;
+        if (netRole == NET_CLIENT) {
+            NetClientUpdate(); //the host runs the game, we only predict our own ship
+        }
+        else {
+            if (netRole == NET_HOST) NetHostReceive();
+            UpdateGameStatus(frameTime);
+            if (netRole == NET_HOST) NetHostUpdate();
         }
+        UpdateNetStats(frameTime);
+        double simEndTime = GetTime();
+        ClearLatchedTaps();
 
         // 3. drawing phase
-        BeginDrawing();
-        ClearBackground(BLACK); 
-
-        DrawSparks(); //stars
-
-        //draw content depending on the current state
-        switch (gameStatus) {
-        case INTRO_MENU:
-            DrawTheMenu();
-            break;
-        case HOW_TO_PLAY:
-            DrawHowToPlay();
-            break;
-        case IN_GAME:
-        case PAUSED_GAME:
-            DrawGameElements(); // ships, enemies, and UI.
-            if (gameStatus == PAUSED_GAME)
-                DrawPauseScreen();
-            break;
-        case END_SCREEN:
-            DrawGameElements(); 
-            DrawEndScreen();   //draw the "game over" display
-            break;
-        case LEVEL_UP:
-            DrawGameElements(); //keep old game state visible during the fade out
+        //menus and pause barely change, reuse the cached picture and only animate the stars on top
+        bool idleScreen = IsIdleScreen(gameStatus) && idleScreenCache.id != 0;
+        if (idleScreen) {
+            RefreshIdleScreenCache();
+        }
+        else {
+            idleCacheValid = false; //ufos and shots move, a cached picture would be stale next time
+        }
 
-            float alpha = 0.0f; //opacity of black screen (0 = transparent, 1 = solid)
+        BeginDrawing();
+        if (idleScreen) {
+            //the overlays left the cached alpha below 1, adding the colours onto black keeps them exact
+            ClearBackground(BLACK);
+            BeginBlendMode(BLEND_ADD_COLORS);
+            //render textures are stored upside down, so flip the source rectangle
+            DrawTextureRec(idleScreenCache.texture,
+                (Rectangle) { 0.0f, 0.0f, static_cast<float>(SCREEN_WIDTH), -static_cast<float>(SCREEN_HEIGHT) },
+                (Vector2) { 0, 0 }, WHITE);
+            EndBlendMode();
+            DrawSparks();
+        }
+        else {
+            ClearBackground(BLACK);
+            DrawSparks(); //stars
+            DrawCurrentScreen();
+        }
 
-            if (levelTransitionTimer < FADE_TIME) {
-                //screen turns solid
-                alpha = levelTransitionTimer / FADE_TIME;
-            }
-            else if (levelTransitionTimer < FADE_TIME + HOLD_TIME) {
-                //screen is solid
-                alpha = 1.0f;
-            }
-            else {
-                //screen turns transparent 
-                alpha = 1.0f - (levelTransitionTimer - (FADE_TIME + HOLD_TIME)) / FADE_TIME;
-            }
-            //draw the fading black screen over everything else 
-            DrawRectangle(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, ColorAlpha(BLACK, alpha));
-            //only draw the text when screen is dark enough to read
-            if (alpha > 0.95f) {
-                DrawLevelUpScreen();
-            }
-            break;
+        if (showLatencyStats) {
+            DrawLatencyStats();
+        }
+        if (netRole != NET_OFFLINE) {
+            DrawNetStats();
         }
 
-        EndDrawing(); //display the frame
+        double submitTime = GetTime();
+        WaitForPresentSlot();
+        EndDrawing(); //display the frame, with vsync this blocks until the vblank
+        lastPresentTime = GetTime();
+        RecordFrameTiming(inputTime, simEndTime, submitTime, lastPresentTime);
     }
 
     // 4. cleanup
+    if (netRole != NET_OFFLINE) {
+        NetSocketClose();
+    }
+    UpdateLatencyStats();
+    if (latencyStats.sampleCount > 0) {
+        printf("input to present latency (%s): p50 %.2f ms, p95 %.2f ms, p99 %.2f ms\n",
+            lowLatencyMode ? "low latency" : "normal",
+            latencyStats.presentP50, latencyStats.presentP95, latencyStats.presentP99);
+    }
+    FreeLevelArena();
+    UnloadRenderTexture(idleScreenCache);
     UnloadAllTextures();
     CloseWindow();
     return 0; // everything ran successfully
@@ -314,6 +602,54 @@ int main(void) {
 
 //game logic functions
 
+// runs one tick of whatever screen we are on
+void UpdateGameStatus(float frameTime) {
+    //depending on where we are menu,game etc corresponding action takes place
+    switch (gameStatus) {
+    case INTRO_MENU:
+        if (KeyTapped(KEY_ENTER)) {
+            InitializeGame();
+            gameStatus = IN_GAME;
+        }
+        else if (KeyTapped(KEY_I)) {
+            gameStatus = HOW_TO_PLAY;
+        }
+        break;
+    case HOW_TO_PLAY:
+        if (KeyTapped(KEY_ENTER) || KeyTapped(KEY_ESCAPE)) {
+            gameStatus = INTRO_MENU;
+        }
+        break;
+    case IN_GAME:
+        UpdateEverything(frameTime);
+        RunScripts(frameTime);
+        //the tick may have ended the level or the game, pausing then would overwrite that
+        if (gameStatus == IN_GAME && KeyTapped(KEY_P)) {
+            gameStatus = PAUSED_GAME;
+        }
+        break;
+    case PAUSED_GAME:
+        if (KeyTapped(KEY_P) || KeyTapped(KEY_ENTER)) {
+            gameStatus = IN_GAME;
+        }
+        break;
+    case LEVEL_UP: //for smooth transition between levels
+        RunScripts(frameTime); //LevelScript runs the fade and brings in the next wave
+        break;
+    case END_SCREEN:
+        //check if current score is the new highscore
+        if (thePlayer.playerScore > highScore) {
+            highScore = thePlayer.playerScore;
+            SaveScoreFile();
+            idleCacheValid = false; //shown on the end screen
+        }
+        if (KeyTapped(KEY_ENTER)) {
+            gameStatus = INTRO_MENU;
+        }
+        break;
+    }
+}
+
 //starry background
 void SetupSparks() {
     for (int i = 0; i < MAX_SPARKS; i++) {
@@ -327,17 +663,23 @@ void SetupSparks() {
     }
 }
 
+// stars drift down and wrap back to the top
+void UpdateSparks(float frameTime) {
+    //velocity is in pixels per 60fps frame, scale it so a lower frame rate doesnt slow the stars
+    float step = frameTime * TARGET_FPS;
+    for (int i = 0; i < MAX_SPARKS; i++) {
+        allSparks[i].pos.y += allSparks[i].velocity.y * step;
+        if (allSparks[i].pos.y > static_cast<float>(SCREEN_HEIGHT)) {
+            allSparks[i].pos = (Vector2){ static_cast<float>(rand() % SCREEN_WIDTH), 0.0f };
+        }
+    }
+}
+
 // resets beofre every level
 void InitializeGame() {
-    currentLevel = 1;
-    gridRows = 2;
-    gridCols = 5;
-    ufoMoveTimer = 0.0f;
-    ufoMoveDirection = 1.0f;
-    timeSinceLastUfoShot = 0.0f;
+    currentLevel = startLevel;
     //reset transition variables 
     levelTransitionTimer = 0.0f;
-    levelResetExecuted = false;
     //put the player ship in its starting position 
     thePlayer.hitBox = { SCREEN_WIDTH / 2.0f - SHIP_W / 2.0f,
                        static_cast<float>(SCREEN_HEIGHT) - SHIP_H - 30,
@@ -346,54 +688,220 @@ void InitializeGame() {
     thePlayer.playerScore = 0;
     thePlayer.fireCooldown = 0.0f;
     thePlayer.tripleShotCooldown = 0.0f;
+    //second ship starts a bit to the right
+    thePartner.hitBox = thePlayer.hitBox;
+    thePartner.hitBox.x += SHIP_W + 40;
+    thePartner.fireCooldown = 0.0f;
+    thePartner.tripleShotCooldown = 0.0f;
     //clear all existing bullets 
     for (int i = 0; i < MAX_SHOTS; i++) {
         allShots[i].isActive = false;
     }
 
     SetupWalls(); //place the defense barriers 
-    SetupUfos(gridRows, gridCols); //place enemies 
+
+    //the level script places the first wave and runs the game from here
+    ResetScripts();
+    SpawnScript(LevelScript());
 }
 
 
 // function for alien grid setup
 void SetupUfos(int rows, int cols) {
     currentUfosAlive = 0;
-
-    // reset all UFOs
-    for (int i = 0; i < MAX_UFOS; i++) {
-        allUfos[i].isAlive = false;
-    }
-
-    // calculate how many aliens to spawn
-    int maxUfosToSpawn = rows * cols;
-    if (maxUfosToSpawn > MAX_UFOS)
-        maxUfosToSpawn = MAX_UFOS;
+    AllocateWaveStorage(rows, cols); //throws away the last wave
 
     // create a grid of UFOs
     for (int r = 0; r < rows; r++) {
         for (int c = 0; c < cols; c++) {
 
             int i = r * cols + c;
-            if (i >= maxUfosToSpawn)
-                break;
-
             allUfos[i].isAlive = true;
             allUfos[i].fireTimer = static_cast<float>(rand() % 500) / 100.0f + 2.0f;
 
-            float gridWidth = static_cast<float>(cols * (UFO_W + 40) - 40); // grid width
-            float startX = (static_cast<float>(SCREEN_WIDTH) - gridWidth) / 2 +
-                static_cast<float>(c * (UFO_W + 40));
-
-            float startY = 50 + static_cast<float>(r * (UFO_H + 20));
-
-            allUfos[i].hitBox = { startX, startY,
+            Vector2 start = UfoSlotPosition(r, c, cols);
+            allUfos[i].hitBox = { start.x, start.y,
                                   static_cast<float>(UFO_W),
                                   static_cast<float>(UFO_H) };
 
             currentUfosAlive++; //count the new enemies 
         }
     }
+
+    BuildColumnIndex();
+}
+
+// resets the level arena and carves the ufos and the column index for a rows x cols wave out of it
+void AllocateWaveStorage(int rows, int cols) {
+    gridRows = rows;
+    gridCols = cols;
+    ufoCount = rows * cols;
+
+    //one block for the whole wave, sized up front so nothing is allocated per ufo
+    size_t bytes = sizeof(Ufo) * ufoCount + sizeof(int) * (4 * cols + 1) + 5 * alignof(Ufo);
+    ResetLevelArena(bytes);
+
+    allUfos = static_cast<Ufo*>(ArenaAlloc(sizeof(Ufo) * ufoCount, alignof(Ufo)));
+    for (int i = 0; i < ufoCount; i++) {
+        new (&allUfos[i]) Ufo();
+    }
+    columnFrontRow = static_cast<int*>(ArenaAlloc(sizeof(int) * cols, alignof(int)));
+    liveColumns = static_cast<int*>(ArenaAlloc(sizeof(int) * cols, alignof(int)));
+    liveColumnSlot = static_cast<int*>(ArenaAlloc(sizeof(int) * cols, alignof(int)));
+    liveColumnTree = static_cast<int*>(ArenaAlloc(sizeof(int) * (cols + 1), alignof(int)));
+    liveColumnCount = 0;
+}
+
+// empties the arena, only goes to the heap when a wave needs more room than any before it
+void ResetLevelArena(size_t bytesNeeded) {
+    levelArena.peakNeeded = max(levelArena.peakNeeded, bytesNeeded);
+    if (bytesNeeded > levelArena.capacity) {
+        free(levelArena.memory);
+        //grow in big steps so slowly growing waves dont reallocate every level
+        size_t capacity = max(bytesNeeded, levelArena.capacity * 2);
+        levelArena.memory = static_cast<unsigned char*>(malloc(capacity));
+        if (levelArena.memory == nullptr) {
+            printf("out of memory for a wave of %zu bytes\n", capacity);
+            exit(1);
+        }
+        levelArena.capacity = capacity;
+        levelArena.heapBlocks++;
+    }
+    levelArena.used = 0;
+}
+
+// next aligned chunk of the arena, the caller sized the arena so this always fits
+void* ArenaAlloc(size_t bytes, size_t align) {
+    size_t start = (levelArena.used + align - 1) & ~(align - 1);
+    levelArena.used = start + bytes;
+    return levelArena.memory + start;
+}
+
+void FreeLevelArena() {
+    free(levelArena.memory);
+    levelArena = {};
+    allUfos = nullptr;
+    ufoCount = 0;
+}
+
+// where the ufo at row r, column c starts in a grid with cols columns
+Vector2 UfoSlotPosition(int r, int c, int cols) {
+    float gridWidth = static_cast<float>(cols * UFO_SPACING_X - 40); // grid width
+    float startX = (static_cast<float>(SCREEN_WIDTH) - gridWidth) / 2 +
+        static_cast<float>(c * UFO_SPACING_X);
+
+    float startY = 50 + static_cast<float>(r * (UFO_H + 20));
+    return { startX, startY };
+}
+
+// finds the front ufo of every column after a new grid is placed
+void BuildColumnIndex() {
+    liveColumnCount = 0;
+    for (int c = 0; c <= gridCols; c++) {
+        liveColumnTree[c] = 0;
+    }
+
+    for (int c = 0; c < gridCols; c++) {
+        columnFrontRow[c] = -1;
+        liveColumnSlot[c] = -1;
+        //walk up from the bottom row
+        for (int r = gridRows - 1; r >= 0; r--) {
+            if (allUfos[r * gridCols + c].isAlive) {
+                columnFrontRow[c] = r;
+                break;
+            }
+        }
+        if (columnFrontRow[c] >= 0) {
+            liveColumnSlot[c] = liveColumnCount;
+            liveColumns[liveColumnCount++] = c;
+            ColumnTreeAdd(c, 1);
+        }
+    }
+}
+
+// called when an ufo dies, moves the front of its column up if needed
+void RemoveUfoFromColumns(int index) {
+    int r = index / gridCols;
+    int c = index % gridCols;
+    if (columnFrontRow[c] != r) return; //a ufo behind the front line died
+
+    int newFront = -1;
+    for (int above = r - 1; above >= 0; above--) {
+        if (allUfos[above * gridCols + c].isAlive) {
+            newFront = above;
+            break;
+        }
+    }
+    columnFrontRow[c] = newFront;
+    if (newFront >= 0) return;
+
+    //column is empty, swap it out of the packed list
+    int slot = liveColumnSlot[c];
+    int lastCol = liveColumns[--liveColumnCount];
+    liveColumns[slot] = lastCol;
+    liveColumnSlot[lastCol] = slot;
+    liveColumnSlot[c] = -1;
+    ColumnTreeAdd(c, -1);
+}
+
+void ColumnTreeAdd(int col, int delta) {
+    for (int i = col + 1; i <= gridCols; i += i & -i) {
+        liveColumnTree[i] += delta;
+    }
+}
+
+// number of live columns in 0..col
+int ColumnTreeCount(int col) {
+    int count = 0;
+    for (int i = col + 1; i > 0; i -= i & -i) {
+        count += liveColumnTree[i];
+    }
+    return count;
+}
+
+// column of the k-th live column from the left (k starts at 1)
+int ColumnTreeFind(int k) {
+    int pos = 0;
+    int step = 1;
+    while (step * 2 <= gridCols) step *= 2;
+
+    for (; step > 0; step /= 2) {
+        if (pos + step <= gridCols && liveColumnTree[pos + step] < k) {
+            pos += step;
+            k -= liveColumnTree[pos];
+        }
+    }
+    return pos; //tree is 1 based so this is already the 0 based column
+}
+
+// closest column to targetCol that still has a ufo, O(log cols)
+int NearestLiveColumn(int targetCol) {
+    int countUpTo = ColumnTreeCount(targetCol);
+    int left = countUpTo > 0 ? ColumnTreeFind(countUpTo) : -1;
+    int right = countUpTo < liveColumnCount ? ColumnTreeFind(countUpTo + 1) : -1;
+
+    if (left < 0) return right;
+    if (right < 0) return left;
+    return (targetCol - left <= right - targetCol) ? left : right;
+}
+
+// picks which column fires next, random unless aimed fire is turned on
+int PickShooterColumn() {
+    if (liveColumnCount == 0) return -1;
+
+    int aimedPercent = KeepInBounds((currentLevel - 1) * AIMED_FIRE_PERCENT_PER_LEVEL, 0, MAX_AIMED_FIRE_PERCENT);
+    if (!AIMED_FIRE_ENABLED || rand() % 100 >= aimedPercent) {
+        return liveColumns[rand() % liveColumnCount];
+    }
+
+    //all columns move together, so any live ufo tells where column 0 is
+    int refCol = liveColumns[0];
+    float column0X = allUfos[columnFrontRow[refCol] * gridCols + refCol].hitBox.x -
+        static_cast<float>(refCol * UFO_SPACING_X);
+    float playerCenter = thePlayer.hitBox.x + thePlayer.hitBox.width / 2;
+    int targetCol = static_cast<int>(roundf((playerCenter - column0X - UFO_W / 2.0f) / UFO_SPACING_X));
+
+    return NearestLiveColumn(KeepInBounds(targetCol, 0, gridCols - 1));
 }
 
 // defence walls
@@ -416,26 +924,13 @@ void SetupWalls() {
 
 
 void UpdateEverything(float frameTime) {
-    MoveShip(frameTime);
-    thePlayer.fireCooldown -= frameTime;
-    thePlayer.tripleShotCooldown -= frameTime;
-
-    // handle normal shooting input
-    if ((IsKeyPressed(KEY_SPACE) || IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) && thePlayer.fireCooldown <= 0) {
-        FireShot(thePlayer.hitBox, false, 0.0f);
-        thePlayer.fireCooldown = SHIP_FIRE_DELAY; // reset timers
-    }
-
-    // handle special triple shot input
-    if (IsKeyPressed(KEY_B) && thePlayer.tripleShotCooldown <= 0) {
-        FireTripleShot();
+    HandleShipInput(thePlayer, ReadLocalInput(), frameTime);
+    if (partnerConnected) {
+        HandleShipInput(thePartner, NextPartnerInput(), frameTime);
     }
 
-    UfoShooting(frameTime);
-    MoveUfos(frameTime);
-    MoveShots(frameTime);
+    MoveShots(frameTime); //the wave scripts move the ufos and fire for them
     CheckHits(); //collisions checker
-    CheckIfLevelWon();
 
     //game over condition checker
     if (thePlayer.livesLeft <= 0) {
@@ -443,17 +938,7 @@ void UpdateEverything(float frameTime) {
     }
 }
 
-// checks if player defeated all enemies in current wave
-void CheckIfLevelWon() {
-    if (currentUfosAlive <= 0) {
-        // we won! Start the fading transition.
-        levelTransitionTimer = 0.0f;
-        levelResetExecuted = false;
-        gameStatus = LEVEL_UP;
-    }
-}
-
-// prepares all game objects fornext level 
+// prepares all game objects fornext level, LevelScript places the new wave after
 void AdvanceLevel() {
 
     // update score and level
@@ -461,23 +946,15 @@ void AdvanceLevel() {
     currentLevel++; 
     thePlayer.playerScore += 500 * previousLevel; 
 
-    // next wave harder
-    gridRows = KeepInBounds(gridRows + 1, 1, 5);
-    gridCols = KeepInBounds(gridCols + 1, 1, 10);
-
     // resets game state
     thePlayer.fireCooldown = 0.0f;
     thePlayer.tripleShotCooldown = 0.0f;
+    thePartner.fireCooldown = 0.0f;
+    thePartner.tripleShotCooldown = 0.0f;
     for (int i = 0; i < MAX_SHOTS; i++) {
         allShots[i].isActive = false;
     }
     SetupWalls();
-    SetupUfos(gridRows, gridCols); 
-
-    // resets timing.
-    ufoMoveTimer = 0.0f;
-    ufoMoveDirection = 1.0f;
-    timeSinceLastUfoShot = 0.0f;
 
     // extra life
     if (currentLevel % 3 == 0) {
@@ -486,18 +963,46 @@ void AdvanceLevel() {
 }
 
 //physics
-// moves the player ship left or right based on input
-void MoveShip(float frameTime) {
-    if (IsKeyDown(KEY_LEFT) || IsKeyDown(KEY_A)) {
-        thePlayer.hitBox.x -= thePlayer.speed;
+// turns the keyboard and mouse state into input bits
+unsigned char ReadLocalInput() {
+    unsigned char input = 0;
+    if (KeyHeld(KEY_LEFT) || KeyHeld(KEY_A)) input |= INPUT_LEFT;
+    if (KeyHeld(KEY_RIGHT) || KeyHeld(KEY_D)) input |= INPUT_RIGHT;
+    if (KeyTapped(KEY_SPACE) || MouseTapped(MOUSE_LEFT_BUTTON)) input |= INPUT_FIRE;
+    if (KeyTapped(KEY_B)) input |= INPUT_TRIPLE;
+    return input;
+}
+
+// moves a ship and fires its shots, same for the local and the remote player
+void HandleShipInput(GamerShip& ship, unsigned char input, float frameTime) {
+    MoveShip(ship, input);
+    ship.fireCooldown -= frameTime;
+    ship.tripleShotCooldown -= frameTime;
+
+    // handle normal shooting input
+    if ((input & INPUT_FIRE) && ship.fireCooldown <= 0) {
+        FireShot(ship.hitBox, false, 0.0f);
+        ship.fireCooldown = SHIP_FIRE_DELAY; // reset timers
+    }
+
+    // handle special triple shot input
+    if ((input & INPUT_TRIPLE) && ship.tripleShotCooldown <= 0) {
+        FireTripleShot(ship);
+    }
+}
+
+// moves a ship left or right based on input
+void MoveShip(GamerShip& ship, unsigned char input) {
+    if (input & INPUT_LEFT) {
+        ship.hitBox.x -= ship.speed;
     }
-    if (IsKeyDown(KEY_RIGHT) || IsKeyDown(KEY_D)) {
-        thePlayer.hitBox.x += thePlayer.speed;
+    if (input & INPUT_RIGHT) {
+        ship.hitBox.x += ship.speed;
     }
 
     // clamp the ship's horizontal position
-    thePlayer.hitBox.x = static_cast<float>(KeepInBounds(static_cast<int>(thePlayer.hitBox.x),
-        0, SCREEN_WIDTH - static_cast<int>(thePlayer.hitBox.width)));
+    ship.hitBox.x = static_cast<float>(KeepInBounds(static_cast<int>(ship.hitBox.x),
+        0, SCREEN_WIDTH - static_cast<int>(ship.hitBox.width)));
 }
 
 // finds empty slot launches a single bullet
@@ -528,85 +1033,11 @@ void FireShot(Rectangle sourceBox, bool isUfo, float offsetX) {
 }
 
 //fire three player shots 
-void FireTripleShot() {
-    thePlayer.tripleShotCooldown = TRIPLE_SHOT_DELAY;
-    FireShot(thePlayer.hitBox, false, -20.0f); //left
-    FireShot(thePlayer.hitBox, false, 0.0f);   //centre
-    FireShot(thePlayer.hitBox, false, 20.0f);  //right
-}
-
-
-// this is for controlooing the lien up down movement and shifts
-void MoveUfos(float frameTime) {
-    ufoMoveTimer += frameTime;
-    if (ufoMoveTimer < BASE_UFO_TIME / static_cast<float>(currentLevel))
-        return;
-
-    ufoMoveTimer = 0.0f;
-
-    bool hitWall = false;
-    //calculates speed which increases the level
-    float currentSpeed = UFO_X_SPEED * (0.8f + static_cast<float>(currentLevel) * 0.2f);
-
-    int maxUfosActive = gridRows * gridCols;
-    if (maxUfosActive > MAX_UFOS)
-        maxUfosActive = MAX_UFOS;
-    //move all active enemies 
-    for (int i = 0; i < maxUfosActive; i++) {
-        if (allUfos[i].isAlive) {
-
-            // Move left or right
-            allUfos[i].hitBox.x += currentSpeed * ufoMoveDirection;
-
-            // Check wall collision
-            if (allUfos[i].hitBox.x <= 0 ||
-                allUfos[i].hitBox.x >= static_cast<float>(SCREEN_WIDTH) - allUfos[i].hitBox.width) {
-                hitWall = true;
-            }
-
-            // Check if aliens reached near bottom of screen, if yes end screen will show
-            if (allUfos[i].hitBox.y + allUfos[i].hitBox.height >=
-                static_cast<float>(SCREEN_HEIGHT) - 100) {
-                gameStatus = END_SCREEN;
-            }
-        }
-    }
-
-    // If any aliens hits a wall then reverse direction and move down
-    if (hitWall) {
-        ufoMoveDirection *= -1.0f;
-
-        for (int i = 0; i < maxUfosActive; i++) {
-            if (allUfos[i].isAlive) {
-                allUfos[i].hitBox.y += UFO_Y_DROP;
-            }
-        }
-    }
-}
-
-// function to control when and how aliens should shoot
-void UfoShooting(float frameTime) {
-    timeSinceLastUfoShot += frameTime;
-
-    const float BASE_UFO_FIRE_INTERVAL = 1.0f;
-    float fireInterval = BASE_UFO_FIRE_INTERVAL / (0.5f + static_cast<float>(currentLevel) * 0.5f);
-
-    if (timeSinceLastUfoShot >= fireInterval && currentUfosAlive > 0) {
-        timeSinceLastUfoShot = 0.0f;
-
-        int aliveIndices[MAX_UFOS];
-        int count = 0;
-        for (int i = 0; i < MAX_UFOS; i++) {
-            if (allUfos[i].isAlive) {
-                aliveIndices[count++] = i;
-            }
-        }
-
-        if (count > 0) {
-            int targetIndex = aliveIndices[rand() % count];
-            FireShot(allUfos[targetIndex].hitBox, true, 0.0f);
-        }
-    }
+void FireTripleShot(GamerShip& ship) {
+    ship.tripleShotCooldown = TRIPLE_SHOT_DELAY;
+    FireShot(ship.hitBox, false, -20.0f); //left
+    FireShot(ship.hitBox, false, 0.0f);   //centre
+    FireShot(ship.hitBox, false, 20.0f);  //right
 }
 
 
@@ -651,19 +1082,22 @@ void CheckHits() {
                     allShots[i].isActive = false;
                     thePlayer.livesLeft--;
                 }
+                //both ships share the lives
+                else if (partnerConnected && CheckCollisionRecs(allShots[i].hitBox, thePartner.hitBox)) {
+                    allShots[i].isActive = false;
+                    thePlayer.livesLeft--;
+                }
             }
             else {
                 // 3. Player Shot vs alien
-                int maxUfosActive = gridRows * gridCols;
-                if (maxUfosActive > MAX_UFOS) maxUfosActive = MAX_UFOS;
-
-                for (int j = 0; j < maxUfosActive; j++) {
+                for (int j = 0; j < ufoCount; j++) {
                     if (allUfos[j].isAlive &&
                         CheckCollisionRecs(allShots[i].hitBox, allUfos[j].hitBox)) {
                         allUfos[j].isAlive = false;
                         allShots[i].isActive = false;
                         thePlayer.playerScore += 100;
                         currentUfosAlive--;
+                        RemoveUfoFromColumns(j);
                         break;
                     }
                 }
@@ -677,6 +1111,70 @@ void CheckHits() {
 
 // drawing
 
+// draws the scene for the current state, everything except the stars
+void DrawCurrentScreen() {
+    //draw content depending on the current state
+    switch (gameStatus) {
+    case INTRO_MENU:
+        DrawTheMenu();
+        break;
+    case HOW_TO_PLAY:
+        DrawHowToPlay();
+        break;
+    case IN_GAME:
+    case PAUSED_GAME:
+        DrawGameElements(); // ships, enemies, and UI.
+        if (gameStatus == PAUSED_GAME)
+            DrawPauseScreen();
+        break;
+    case END_SCREEN:
+        DrawGameElements(); 
+        DrawEndScreen();   //draw the "game over" display
+        break;
+    case LEVEL_UP:
+        DrawGameElements(); //keep old game state visible during the fade out
+
+        float alpha = 0.0f; //opacity of black screen (0 = transparent, 1 = solid)
+
+        if (levelTransitionTimer < FADE_TIME) {
+            //screen turns solid
+            alpha = levelTransitionTimer / FADE_TIME;
+        }
+        else if (levelTransitionTimer < FADE_TIME + HOLD_TIME) {
+            //screen is solid
+            alpha = 1.0f;
+        }
+        else {
+            //screen turns transparent 
+            alpha = 1.0f - (levelTransitionTimer - (FADE_TIME + HOLD_TIME)) / FADE_TIME;
+        }
+        //draw the fading black screen over everything else 
+        DrawRectangle(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, ColorAlpha(BLACK, alpha));
+        //only draw the text when screen is dark enough to read
+        if (alpha > 0.95f) {
+            DrawLevelUpScreen();
+        }
+        break;
+    }
+}
+
+// screens where nothing but the stars moves
+bool IsIdleScreen(GameStatus status) {
+    return status == INTRO_MENU || status == HOW_TO_PLAY || status == PAUSED_GAME || status == END_SCREEN;
+}
+
+// redraws the cached screen only if it is out of date
+void RefreshIdleScreenCache() {
+    if (idleCacheValid && gameStatus == idleCacheStatus) return;
+
+    BeginTextureMode(idleScreenCache);
+    ClearBackground(BLACK);
+    DrawCurrentScreen();
+    EndTextureMode();
+    idleCacheStatus = gameStatus;
+    idleCacheValid = true;
+}
+
 // moving background
 void DrawSparks() {
     for (int i = 0; i < MAX_SPARKS; i++) {
@@ -688,11 +1186,8 @@ void DrawSparks() {
 
 // drawing main objects / elements
 void DrawGameElements() {
-    int maxUfosActive = gridRows * gridCols;
-    if (maxUfosActive > MAX_UFOS) maxUfosActive = MAX_UFOS;
-
     // draw ufos if alive
-    for (int i = 0; i < maxUfosActive; i++) {
+    for (int i = 0; i < ufoCount; i++) {
         if (allUfos[i].isAlive) {
             
             DrawTexturePro(ufoTexture,
@@ -716,6 +1211,18 @@ void DrawGameElements() {
         0, 0
     }, 0.0f, WHITE);
 
+    //second player ship, tinted so both players can tell them apart
+    if (partnerConnected) {
+        DrawTexturePro(shipTexture,
+            (Rectangle) {
+            0.0f, 0.0f, static_cast<float>(shipTexture.width), static_cast<float>(shipTexture.height)
+        },
+            thePartner.hitBox,
+            (Vector2) {
+            0, 0
+        }, 0.0f, SKYBLUE);
+    }
+
     // draw shots
     for (int i = 0; i < MAX_SHOTS; i++) {
         if (allShots[i].isActive) {
@@ -746,9 +1253,10 @@ void DrawGameElements() {
     int livesTextWidth = MeasureText(livesText, LIVES_TEXT_SIZE);
     DrawText(livesText, SCREEN_WIDTH - livesTextWidth - 10, 10, LIVES_TEXT_SIZE, WHITE);
 
-    // triple shot timer
-    Color cdColor = thePlayer.tripleShotCooldown <= 0.0f ? LIME : RED;
-    DrawText(TextFormat("TRIPLE SHOT CD: %.1f", thePlayer.tripleShotCooldown > 0.0f ? thePlayer.tripleShotCooldown : 0.0f), 10, 40, 20, cdColor);
+    // triple shot timer of whichever ship is ours
+    const GamerShip& localShip = netRole == NET_CLIENT ? thePartner : thePlayer;
+    Color cdColor = localShip.tripleShotCooldown <= 0.0f ? LIME : RED;
+    DrawText(TextFormat("TRIPLE SHOT CD: %.1f", localShip.tripleShotCooldown > 0.0f ? localShip.tripleShotCooldown : 0.0f), 10, 40, 20, cdColor);
 }
 
 //main title
@@ -772,6 +1280,7 @@ void DrawHowToPlay() {
     DrawText("Destroy all viruses to advance to the next level.", 50, 300, 30, LIGHTGRAY);
     DrawText("The permanent BARRIERS STOP ALL BULLETS and protect the player.", 50, 350, 30, LIGHTGRAY);
     DrawText("You get an extra life every 3 levels.", 50, 400, 30, LIGHTGRAY);
+    DrawText("Press L for LOW LATENCY mode, F1 shows input lag.", 50, 450, 30, LIGHTGRAY);
     DrawText("Press ESCAPE to return to Menu", 50, SCREEN_HEIGHT - 50, 30, RED);
 }
 
@@ -801,3 +1310,1262 @@ void DrawLevelUpScreen() {
 
 
 
+
+
+//frame pacing
+
+// uses vsync to time the frames when the monitor runs at our rate, otherwise our own timer does
+void StartFramePacing() {
+    SetTargetFPS(0); //the raylib limiter would sleep inside EndDrawing where we cant measure it
+    if (GetMonitorRefreshRate(GetCurrentMonitor()) == TARGET_FPS) {
+        SetWindowState(FLAG_VSYNC_HINT);
+        vsyncPacing = true;
+    }
+}
+
+//switches between simulating right after a present and as late as possible before the next one
+void SetLowLatencyMode(bool enabled) {
+    lowLatencyMode = enabled;
+    //old samples belong to the other mode
+    frameTimingCount = 0;
+    frameTimingNext = 0;
+    latencyStats = {};
+}
+
+// pause runs slower, nothing moves but the stars
+double CurrentFramePeriod() {
+    return gameStatus == PAUSED_GAME ? 1.0 / PAUSED_FPS : TARGET_FRAME_TIME;
+}
+
+// works out when the frame we are about to make will be shown
+void PlanNextPresent() {
+    double period = CurrentFramePeriod();
+    if (vsyncPacing) {
+        //the last swap returned on a vblank, the next one is a refresh later
+        nextPresentTime = lastPresentTime + period;
+        return;
+    }
+    //fixed schedule so the game keeps 60 ticks a second
+    nextPresentTime += period;
+    if (nextPresentTime <= lastPresentTime) {
+        nextPresentTime = lastPresentTime + period; //missed a whole slot (window drag, breakpoint), dont try to catch up
+    }
+}
+
+// os sleep, plus a busy wait for the last couple of ms when timing has to be tight
+void SleepUntil(double time, bool spin) {
+    double sleepTime = time - GetTime() - (spin ? PACING_SPIN_TIME : 0.0);
+    if (sleepTime > 0.0) {
+        WaitTime(sleepTime);
+    }
+    while (spin && GetTime() < time) {
+        //spin
+    }
+}
+
+// low latency mode: sleeps until just enough time is left to make the frame, then polls input
+void WaitForLateInput() {
+    SleepUntil(nextPresentTime - frameWorkEstimate - PACING_SAFETY_MARGIN, gameStatus != PAUSED_GAME);
+
+    //EndDrawing already polled once, keep those presses before polling again
+    for (int i = 0; i < NUM_TAP_KEYS; i++) {
+        latchedKeyTaps[i] = IsKeyPressed(TAP_KEYS[i]);
+    }
+    latchedMouseTap = IsMouseButtonPressed(MOUSE_LEFT_BUTTON);
+    PollInputEvents();
+}
+
+// holds the finished frame until its slot when the swap doesnt wait for the vblank itself
+void WaitForPresentSlot() {
+    if (!vsyncPacing) {
+        SleepUntil(nextPresentTime, lowLatencyMode);
+    }
+    else if (gameStatus == PAUSED_GAME) {
+        SleepUntil(nextPresentTime - TARGET_FRAME_TIME, false); //the swap then lands on the vblank after
+    }
+}
+
+void ClearLatchedTaps() {
+    for (int i = 0; i < NUM_TAP_KEYS; i++) {
+        latchedKeyTaps[i] = false;
+    }
+    latchedMouseTap = false;
+}
+
+// same as IsKeyPressed but also sees presses caught before the late poll
+bool KeyTapped(int key) {
+    if (botInput) {
+        for (int i = 0; i < botTappedCount; i++) {
+            if (botTappedKeys[i] == key) return true;
+        }
+        return false;
+    }
+    for (int i = 0; i < NUM_TAP_KEYS; i++) {
+        if (TAP_KEYS[i] == key && latchedKeyTaps[i]) {
+            return true;
+        }
+    }
+    return IsKeyPressed(key);
+}
+
+bool MouseTapped(int button) {
+    if (botInput) return false;
+    if (button == MOUSE_LEFT_BUTTON && latchedMouseTap) {
+        return true;
+    }
+    return IsMouseButtonPressed(button);
+}
+
+// IsKeyDown that the soak bot can hold down too
+bool KeyHeld(int key) {
+    if (botInput) {
+        return (key == KEY_LEFT && botHoldLeft) || (key == KEY_RIGHT && botHoldRight);
+    }
+    return IsKeyDown(key);
+}
+
+// stores one frame in the ring buffer and updates the work time estimate
+void RecordFrameTiming(double inputTime, double simEndTime, double submitTime, double presentTime) {
+    frameTimings[frameTimingNext] = { inputTime, simEndTime, submitTime, presentTime };
+    frameTimingNext = (frameTimingNext + 1) % LATENCY_SAMPLES;
+    if (frameTimingCount < LATENCY_SAMPLES) {
+        frameTimingCount++;
+    }
+
+    //smoothed, but jumps up quickly so a slow frame doesnt miss the next deadline
+    //up to the swap only, time spent blocked on the vblank isnt work
+    double work = submitTime - inputTime;
+    if (work > frameWorkEstimate) {
+        frameWorkEstimate = work;
+    }
+    else {
+        frameWorkEstimate = frameWorkEstimate * 0.95 + work * 0.05;
+    }
+
+    //refresh the percentiles a few times a second, sorting every frame is a waste
+    if (frameTimingNext % 15 == 0) {
+        UpdateLatencyStats();
+    }
+}
+
+// sorts the recorded samples and picks out the percentiles
+void UpdateLatencyStats() {
+    float simMs[LATENCY_SAMPLES];
+    float presentMs[LATENCY_SAMPLES];
+    int count = frameTimingCount;
+
+    for (int i = 0; i < count; i++) {
+        simMs[i] = static_cast<float>((frameTimings[i].simEndTime - frameTimings[i].inputTime) * 1000.0);
+        presentMs[i] = static_cast<float>((frameTimings[i].presentTime - frameTimings[i].inputTime) * 1000.0);
+    }
+    latencyStats.sampleCount = count;
+    if (count == 0) return;
+
+    sort(simMs, simMs + count);
+    sort(presentMs, presentMs + count);
+
+    //nearest rank percentile
+    auto rank = [count](float p) { return KeepInBounds(static_cast<int>(ceil(p * count)) - 1, 0, count - 1); };
+    latencyStats.simP50 = simMs[rank(0.50f)];
+    latencyStats.simP95 = simMs[rank(0.95f)];
+    latencyStats.simP99 = simMs[rank(0.99f)];
+    latencyStats.presentP50 = presentMs[rank(0.50f)];
+    latencyStats.presentP95 = presentMs[rank(0.95f)];
+    latencyStats.presentP99 = presentMs[rank(0.99f)];
+}
+
+// small overlay in the bottom left corner
+void DrawLatencyStats() {
+    int y = SCREEN_HEIGHT - 70;
+    DrawText(TextFormat("PACING: %s (L)  %s", lowLatencyMode ? "LOW LATENCY" : "NORMAL", vsyncPacing ? "VSYNC" : "TIMER"),
+        10, y, 20, GRAY);
+    DrawText(TextFormat("INPUT->SIM     p50 %.1f  p95 %.1f  p99 %.1f ms",
+        latencyStats.simP50, latencyStats.simP95, latencyStats.simP99), 10, y + 22, 20, GRAY);
+    DrawText(TextFormat("INPUT->PRESENT p50 %.1f  p95 %.1f  p99 %.1f ms",
+        latencyStats.presentP50, latencyStats.presentP95, latencyStats.presentP99), 10, y + 44, 20, GRAY);
+}
+
+
+//networking, the host runs the game and the client only draws it
+
+// reads the command line, -host [port] or -join address [port]
+void StartNetworkFromArgs(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        bool host = strcmp(argv[i], "-host") == 0;
+        bool join = strcmp(argv[i], "-join") == 0 && i + 1 < argc;
+        if (!host && !join) continue;
+
+        const char* address = join ? argv[++i] : nullptr;
+        unsigned short port = NET_DEFAULT_PORT;
+        if (i + 1 < argc && argv[i + 1][0] != '-') {
+            port = static_cast<unsigned short>(atoi(argv[++i]));
+        }
+
+        //the client binds any free port, the host listens on the given one
+        if (!NetSocketOpen(host ? port : 0) || (join && !NetSocketSetPeer(address, port))) {
+            printf("could not start networking on port %d\n", port);
+            NetSocketClose();
+            return;
+        }
+        netRole = host ? NET_HOST : NET_CLIENT;
+        if (join) {
+            partnerConnected = true; //we are the partner
+        }
+        return;
+    }
+}
+
+void PutU8(NetWriter& w, unsigned int v) {
+    if (w.size + 1 > w.capacity) { w.overflow = true; return; }
+    w.data[w.size++] = static_cast<unsigned char>(v);
+}
+
+void PutU16(NetWriter& w, unsigned int v) {
+    PutU8(w, v & 0xFF);
+    PutU8(w, (v >> 8) & 0xFF);
+}
+
+void PutU32(NetWriter& w, unsigned int v) {
+    PutU16(w, v & 0xFFFF);
+    PutU16(w, (v >> 16) & 0xFFFF);
+}
+
+unsigned int GetU8(NetReader& r) {
+    if (r.pos + 1 > r.size) { r.overflow = true; return 0; }
+    return r.data[r.pos++];
+}
+
+unsigned int GetU16(NetReader& r) {
+    unsigned int lo = GetU8(r);
+    return lo | (GetU8(r) << 8);
+}
+
+unsigned int GetU32(NetReader& r) {
+    unsigned int lo = GetU16(r);
+    return lo | (GetU16(r) << 16);
+}
+
+// positions go over the wire as 16 bit quarter pixels
+int QuantizePos(float v) {
+    return KeepInBounds(static_cast<int>(roundf(v * NET_POS_SCALE)), -32768, 32767);
+}
+
+void PutPos(NetWriter& w, int q) {
+    PutU16(w, static_cast<unsigned int>(q) & 0xFFFF);
+}
+
+int GetPos(NetReader& r) {
+    return static_cast<short>(GetU16(r));
+}
+
+// bit per entity, 8 to a byte
+void PutBits(NetWriter& w, const bool* flags, int count) {
+    for (int i = 0; i < count; i += 8) {
+        unsigned int byte = 0;
+        for (int b = 0; b < 8 && i + b < count; b++) {
+            if (flags[i + b]) byte |= 1u << b;
+        }
+        PutU8(w, byte);
+    }
+}
+
+// bytes WriteSnapshot produces for a wave with this many ufos
+int SnapshotSize(int ufos) {
+    return NET_SNAPSHOT_BASE + (ufos + 7) / 8 + 4 * ufos;
+}
+
+// packs the whole game state into a fixed layout, so unchanged parts line up byte for byte
+// ufo positions are stored relative to their grid slot plus one shared formation offset,
+// which is all zeros while the formation moves together
+int WriteSnapshot(unsigned char* out, int capacity) {
+    NetWriter w = { out, capacity };
+
+    PutU8(w, gameStatus);
+    PutU16(w, currentLevel);
+    PutU16(w, static_cast<unsigned int>(levelTransitionTimer * 1000.0f));
+    PutU16(w, gridRows);
+    PutU16(w, gridCols);
+    PutU32(w, thePlayer.playerScore);
+    PutU16(w, thePlayer.livesLeft);
+    PutU32(w, highScore);
+    PutU16(w, partnerAppliedSeq);
+    PutPos(w, QuantizePos(thePlayer.hitBox.x));
+    PutPos(w, QuantizePos(thePartner.hitBox.x));
+    PutU8(w, static_cast<unsigned int>(max(thePlayer.tripleShotCooldown, 0.0f) * 10.0f));
+    PutU8(w, static_cast<unsigned int>(max(thePartner.tripleShotCooldown, 0.0f) * 10.0f));
+
+    //formation offset taken from any live ufo
+    int offsetX = 0;
+    int offsetY = 0;
+    if (liveColumnCount > 0) {
+        int col = liveColumns[0];
+        int row = columnFrontRow[col];
+        Vector2 slot = UfoSlotPosition(row, col, gridCols);
+        const Rectangle& box = allUfos[row * gridCols + col].hitBox;
+        offsetX = QuantizePos(box.x) - QuantizePos(slot.x);
+        offsetY = QuantizePos(box.y) - QuantizePos(slot.y);
+    }
+    PutPos(w, offsetX);
+    PutPos(w, offsetY);
+
+    for (int i = 0; i < ufoCount; i += 8) {
+        unsigned int byte = 0;
+        for (int b = 0; b < 8 && i + b < ufoCount; b++) {
+            if (allUfos[i + b].isAlive) byte |= 1u << b;
+        }
+        PutU8(w, byte);
+    }
+    for (int i = 0; i < ufoCount; i++) {
+        int dx = 0;
+        int dy = 0;
+        if (allUfos[i].isAlive) {
+            Vector2 slot = UfoSlotPosition(i / gridCols, i % gridCols, gridCols);
+            dx = QuantizePos(allUfos[i].hitBox.x) - QuantizePos(slot.x) - offsetX;
+            dy = QuantizePos(allUfos[i].hitBox.y) - QuantizePos(slot.y) - offsetY;
+        }
+        PutPos(w, dx);
+        PutPos(w, dy);
+    }
+
+    bool shotActive[MAX_SHOTS];
+    bool shotByUfo[MAX_SHOTS];
+    for (int i = 0; i < MAX_SHOTS; i++) {
+        shotActive[i] = allShots[i].isActive;
+        shotByUfo[i] = allShots[i].isActive && allShots[i].firedByUfo;
+    }
+    PutBits(w, shotActive, MAX_SHOTS);
+    PutBits(w, shotByUfo, MAX_SHOTS);
+    for (int i = 0; i < MAX_SHOTS; i++) {
+        PutPos(w, allShots[i].isActive ? QuantizePos(allShots[i].hitBox.x) : 0);
+        PutPos(w, allShots[i].isActive ? QuantizePos(allShots[i].hitBox.y) : 0);
+    }
+
+    for (int i = 0; i < NUM_WALLS; i++) {
+        PutU8(w, allWalls[i].hitPoints);
+    }
+    return w.overflow ? -1 : w.size;
+}
+
+// client side, unpacks a snapshot written by WriteSnapshot into the game arrays
+bool ReadSnapshot(const unsigned char* data, int size) {
+    NetReader r = { data, size };
+
+    unsigned int status = GetU8(r);
+    unsigned int level = GetU16(r);
+    unsigned int timer = GetU16(r);
+    int rows = GetU16(r);
+    int cols = GetU16(r);
+    //check everything before touching the game, a broken packet must not change anything
+    //rows and cols are checked one by one first so rows * cols cant overflow
+    if (status > LEVEL_UP || rows <= 0 || cols <= 0 || rows > NET_MAX_WAVE_UFOS || cols > NET_MAX_WAVE_UFOS ||
+        rows * cols > NET_MAX_WAVE_UFOS || size != SnapshotSize(rows * cols)) {
+        return false;
+    }
+    //from here on the size matches the layout, so no read can run past the end
+
+    gameStatus = static_cast<GameStatus>(status);
+    currentLevel = level;
+    levelTransitionTimer = static_cast<float>(timer) / 1000.0f;
+    thePlayer.playerScore = GetU32(r);
+    thePlayer.livesLeft = GetU16(r);
+    highScore = GetU32(r);
+    partnerAppliedSeq = static_cast<unsigned short>(GetU16(r));
+    thePlayer.hitBox.x = GetPos(r) / NET_POS_SCALE;
+    thePartner.hitBox.x = GetPos(r) / NET_POS_SCALE;
+    thePlayer.tripleShotCooldown = GetU8(r) / 10.0f;
+    thePartner.tripleShotCooldown = GetU8(r) / 10.0f;
+    if (rows != gridRows || cols != gridCols || allUfos == nullptr) {
+        AllocateWaveStorage(rows, cols); //new wave on the host
+    }
+
+    int offsetX = GetPos(r);
+    int offsetY = GetPos(r);
+
+    currentUfosAlive = 0;
+    for (int i = 0; i < ufoCount; i += 8) {
+        unsigned int byte = GetU8(r);
+        for (int b = 0; b < 8 && i + b < ufoCount; b++) {
+            allUfos[i + b].isAlive = (byte >> b) & 1;
+            if (allUfos[i + b].isAlive) currentUfosAlive++;
+        }
+    }
+    for (int i = 0; i < ufoCount; i++) {
+        Vector2 slot = UfoSlotPosition(i / gridCols, i % gridCols, gridCols);
+        int dx = GetPos(r);
+        int dy = GetPos(r);
+        allUfos[i].hitBox = {
+            (QuantizePos(slot.x) + offsetX + dx) / NET_POS_SCALE,
+            (QuantizePos(slot.y) + offsetY + dy) / NET_POS_SCALE,
+            static_cast<float>(UFO_W), static_cast<float>(UFO_H) };
+    }
+
+    for (int i = 0; i < MAX_SHOTS; i += 8) {
+        unsigned int byte = GetU8(r);
+        for (int b = 0; b < 8 && i + b < MAX_SHOTS; b++) {
+            allShots[i + b].isActive = (byte >> b) & 1;
+        }
+    }
+    for (int i = 0; i < MAX_SHOTS; i += 8) {
+        unsigned int byte = GetU8(r);
+        for (int b = 0; b < 8 && i + b < MAX_SHOTS; b++) {
+            allShots[i + b].firedByUfo = (byte >> b) & 1;
+        }
+    }
+    for (int i = 0; i < MAX_SHOTS; i++) {
+        allShots[i].hitBox = { GetPos(r) / NET_POS_SCALE, GetPos(r) / NET_POS_SCALE,
+                               static_cast<float>(SHOT_W), static_cast<float>(SHOT_H) };
+    }
+
+    for (int i = 0; i < NUM_WALLS; i++) {
+        allWalls[i].hitPoints = GetU8(r);
+    }
+    return !r.overflow;
+}
+
+// xor against the baseline and squeeze out the runs of unchanged (zero) bytes
+// format: [zero run][literal count][literal bytes] repeated until size bytes are covered
+int EncodeDelta(const unsigned char* current, int size, const unsigned char* baseline, int baselineSize,
+    unsigned char* out, int capacity) {
+    auto delta = [&](int i) { return static_cast<unsigned char>(current[i] ^ (i < baselineSize ? baseline[i] : 0)); };
+
+    int pos = 0;
+    int outSize = 0;
+    while (pos < size) {
+        int zeros = 0;
+        while (pos + zeros < size && zeros < 255 && delta(pos + zeros) == 0) zeros++;
+        int literalStart = pos + zeros;
+        int literals = 0;
+        while (literalStart + literals < size && literals < 255 && delta(literalStart + literals) != 0) literals++;
+
+        if (outSize + 2 + literals > capacity) return -1;
+        out[outSize++] = static_cast<unsigned char>(zeros);
+        out[outSize++] = static_cast<unsigned char>(literals);
+        for (int i = 0; i < literals; i++) {
+            out[outSize++] = delta(literalStart + i);
+        }
+        pos = literalStart + literals;
+    }
+    return outSize;
+}
+
+// undoes EncodeDelta, returns -1 if the packet doesnt add up
+int DecodeDelta(const unsigned char* encoded, int encodedSize, const unsigned char* baseline, int baselineSize,
+    unsigned char* out, int outSize) {
+    int in = 0;
+    int pos = 0;
+    while (pos < outSize) {
+        if (in + 2 > encodedSize) return -1;
+        int zeros = encoded[in++];
+        int literals = encoded[in++];
+        if (pos + zeros + literals > outSize || in + literals > encodedSize) return -1;
+
+        for (int i = 0; i < zeros + literals; i++, pos++) {
+            unsigned char base = pos < baselineSize ? baseline[pos] : 0;
+            out[pos] = i < zeros ? base : static_cast<unsigned char>(base ^ encoded[in++]);
+        }
+    }
+    return pos;
+}
+
+// snapshot with this id if it is still in the history
+const NetSnapshot* FindSnapshot(unsigned int id) {
+    const NetSnapshot& snap = netHistory[id % NET_SNAPSHOT_HISTORY];
+    return (id != 0 && snap.id == id) ? &snap : nullptr;
+}
+
+// true if sequence number a comes after b, works across wrap around
+bool SeqNewer(unsigned short a, unsigned short b) {
+    return static_cast<short>(a - b) > 0;
+}
+
+void NetSend(const unsigned char* data, int size) {
+    if (NetSocketSend(data, size) > 0) {
+        netBytesOut += size + NET_UDP_OVERHEAD;
+    }
+}
+
+// host: reads input packets from the client
+void NetHostReceive() {
+    unsigned char packet[NET_MAX_PACKET];
+    int size;
+    while ((size = NetSocketReceive(packet, NET_MAX_PACKET)) > 0) {
+        netBytesIn += size + NET_UDP_OVERHEAD;
+        NetReader r = { packet, size };
+        if (GetU8(r) != NET_PACKET_INPUT) continue;
+
+        unsigned int ackId = GetU32(r);
+        unsigned short newestSeq = static_cast<unsigned short>(GetU16(r));
+        int count = GetU8(r);
+        if (r.overflow || count > NET_INPUT_REDUNDANCY) continue;
+
+        //inputs come newest first, queue the ones we havent seen oldest first
+        unsigned char bits[NET_INPUT_REDUNDANCY];
+        for (int k = 0; k < count; k++) {
+            bits[k] = static_cast<unsigned char>(GetU8(r));
+        }
+        if (r.overflow || r.pos != size) continue;
+
+        //only a well formed input packet can claim the free partner slot
+        if (!partnerConnected) {
+            NetSocketAcceptSender();
+            partnerConnected = true;
+            partnerQueuedSeq = static_cast<unsigned short>(newestSeq - count);
+            partnerAppliedSeq = partnerQueuedSeq;
+        }
+        partnerSilentTicks = 0;
+        if (ackId > netAckedId && ackId <= netSnapshotId) {
+            netAckedId = ackId;
+        }
+        for (int k = count - 1; k >= 0; k--) {
+            unsigned short seq = static_cast<unsigned short>(newestSeq - k);
+            if (!SeqNewer(seq, partnerQueuedSeq)) continue;
+
+            if (partnerInputCount == NET_MAX_QUEUED_INPUTS) {
+                //client is running ahead of us, drop the oldest
+                for (int q = 1; q < partnerInputCount; q++) partnerInputs[q - 1] = partnerInputs[q];
+                partnerInputCount--;
+            }
+            partnerInputs[partnerInputCount++] = { seq, bits[k] };
+            partnerQueuedSeq = seq;
+        }
+    }
+}
+
+// host: the partner went quiet, free the slot so a restarted or new client can join
+void DisconnectPartner() {
+    partnerConnected = false;
+    NetSocketClearPeer();
+    partnerInputCount = 0;
+    partnerHeldInput = 0;
+    partnerSilentTicks = 0;
+    netAckedId = 0; //the next client has none of our snapshots
+}
+
+// host: one input per tick for the partner ship, holds the last movement if nothing arrived
+unsigned char NextPartnerInput() {
+    if (partnerInputCount == 0) {
+        return partnerHeldInput;
+    }
+    PendingInput next = partnerInputs[0];
+    for (int q = 1; q < partnerInputCount; q++) partnerInputs[q - 1] = partnerInputs[q];
+    partnerInputCount--;
+
+    partnerAppliedSeq = next.seq;
+    partnerHeldInput = next.bits & (INPUT_LEFT | INPUT_RIGHT);
+    return next.bits;
+}
+
+// host: after simulating, send the state delta compressed against what the client acked
+void NetHostUpdate() {
+    //outside the game the partner doesnt move, so inputs are just used up
+    if (gameStatus != IN_GAME && partnerInputCount > 0) {
+        partnerAppliedSeq = partnerInputs[partnerInputCount - 1].seq;
+        partnerInputCount = 0;
+    }
+
+    if (partnerConnected && ++partnerSilentTicks > NET_PARTNER_TIMEOUT) {
+        DisconnectPartner();
+    }
+
+    netTickCounter++;
+    if (!partnerConnected || !NetSocketHasPeer() || netTickCounter % NET_SNAPSHOT_INTERVAL != 0) return;
+
+    unsigned int id = netSnapshotId + 1;
+    NetSnapshot& snap = netHistory[id % NET_SNAPSHOT_HISTORY];
+    snap.size = WriteSnapshot(snap.data, NET_MAX_SNAPSHOT);
+    if (snap.size < 0) {
+        snap.id = 0;
+        netSnapshotsDropped++;
+        return;
+    }
+    snap.id = id;
+    netSnapshotId = id;
+
+    const NetSnapshot* baseline = FindSnapshot(netAckedId);
+    unsigned char packet[NET_MAX_PACKET];
+    NetWriter w = { packet, NET_MAX_PACKET };
+    PutU8(w, NET_PACKET_SNAPSHOT);
+    PutU32(w, id);
+    PutU32(w, baseline ? baseline->id : 0);
+    PutU16(w, snap.size);
+
+    int encoded = EncodeDelta(snap.data, snap.size, baseline ? baseline->data : nullptr, baseline ? baseline->size : 0,
+        packet + w.size, NET_MAX_PACKET - w.size);
+    if (encoded < 0) {
+        netSnapshotsDropped++; //cant happen within NET_MAX_WAVE_UFOS, shown in the net stats if it does
+        return;
+    }
+    NetSend(packet, w.size + encoded);
+}
+
+// client: puts a decoded snapshot into the game and replays our unconfirmed inputs on top
+void ApplyClientSnapshot(const NetSnapshot& snap) {
+    //the host can change what an idle screen shows, so any new state redraws the cache
+    const NetSnapshot* shown = FindSnapshot(netAppliedId);
+    if (!shown || shown->size != snap.size || memcmp(shown->data, snap.data, snap.size) != 0) {
+        idleCacheValid = false;
+    }
+    if (!ReadSnapshot(snap.data, snap.size)) return;
+    netAppliedId = snap.id;
+
+    if (gameStatus == IN_GAME) {
+        unsigned short seq = partnerAppliedSeq;
+        int replayed = 0;
+        while (SeqNewer(clientInputSeq, seq) && replayed < NET_INPUT_HISTORY) {
+            seq++;
+            MoveShip(thePartner, clientInputHistory[seq % NET_INPUT_HISTORY]);
+            replayed++;
+        }
+    }
+}
+
+// client: reads snapshots, predicts our own ship and sends our input to the host
+void NetClientUpdate() {
+    unsigned char packet[NET_MAX_PACKET];
+    NetSnapshot decoded;
+    const NetSnapshot* newest = nullptr;
+    int size;
+
+    while ((size = NetSocketReceive(packet, NET_MAX_PACKET)) > 0) {
+        netBytesIn += size + NET_UDP_OVERHEAD;
+        NetReader r = { packet, size };
+        if (GetU8(r) != NET_PACKET_SNAPSHOT) continue;
+
+        unsigned int id = GetU32(r);
+        unsigned int baselineId = GetU32(r);
+        int rawSize = GetU16(r);
+        if (r.overflow || id <= netSnapshotId || rawSize > NET_MAX_SNAPSHOT) continue; //late or broken
+
+        const NetSnapshot* baseline = FindSnapshot(baselineId);
+        if (baselineId != 0 && !baseline) continue; //we dont have what it was compressed against
+        decoded.size = DecodeDelta(packet + r.pos, size - r.pos, baseline ? baseline->data : nullptr,
+            baseline ? baseline->size : 0, decoded.data, rawSize);
+        if (decoded.size != rawSize) continue;
+
+        decoded.id = id;
+        netHistory[id % NET_SNAPSHOT_HISTORY] = decoded;
+        netSnapshotId = id;
+        newest = &netHistory[id % NET_SNAPSHOT_HISTORY];
+    }
+    if (newest) {
+        ApplyClientSnapshot(*newest);
+    }
+
+    //predict our own movement right away instead of waiting for the host
+    unsigned char input = ReadLocalInput();
+    clientInputSeq++;
+    clientInputHistory[clientInputSeq % NET_INPUT_HISTORY] = input;
+    if (gameStatus == IN_GAME) {
+        MoveShip(thePartner, input);
+    }
+
+    NetWriter w = { packet, NET_MAX_PACKET };
+    PutU8(w, NET_PACKET_INPUT);
+    PutU32(w, netSnapshotId);
+    PutU16(w, clientInputSeq);
+    int count = min(NET_INPUT_REDUNDANCY, static_cast<int>(clientInputSeq));
+    PutU8(w, count);
+    for (int k = 0; k < count; k++) {
+        PutU8(w, clientInputHistory[static_cast<unsigned short>(clientInputSeq - k) % NET_INPUT_HISTORY]);
+    }
+    NetSend(packet, w.size);
+}
+
+// averages the byte counters over one second
+void UpdateNetStats(float frameTime) {
+    if (netRole == NET_OFFLINE) return;
+
+    netWindowTicks++;
+    netWindowTime += frameTime;
+    if (netWindowTime < 1.0f) return;
+
+    netBytesOutPerTick = static_cast<float>(netBytesOut) / netWindowTicks;
+    netBytesInPerTick = static_cast<float>(netBytesIn) / netWindowTicks;
+    netKbOutPerSec = netBytesOut / 1024.0f / netWindowTime;
+    netKbInPerSec = netBytesIn / 1024.0f / netWindowTime;
+    netBytesOut = 0;
+    netBytesIn = 0;
+    netWindowTicks = 0;
+    netWindowTime = 0.0f;
+}
+
+void DrawNetStats() {
+    const char* status = netRole == NET_HOST ? (partnerConnected ? "HOST" : "HOST - WAITING FOR PLAYER 2")
+                                             : (netSnapshotId > 0 ? "CLIENT" : "CLIENT - WAITING FOR HOST");
+    DrawText(status, 10, 70, 20, GRAY);
+    DrawText(TextFormat("OUT %.2f KB/s (%.0f B/tick)  IN %.2f KB/s (%.0f B/tick)",
+        netKbOutPerSec, netBytesOutPerTick, netKbInPerSec, netBytesInPerTick), 10, 92, 20, GRAY);
+    if (netSnapshotsDropped > 0) {
+        DrawText(TextFormat("SNAPSHOTS TOO BIG TO SEND: %d", netSnapshotsDropped), 10, 114, 20, RED);
+    }
+}
+
+
+//scripting
+
+void* ScriptPoolAlloc(size_t size) {
+    if (!scriptPoolReady) {
+        //chain all blocks into the free list the first time
+        for (int i = 0; i < SCRIPT_POOL_SIZE; i++) {
+            *reinterpret_cast<void**>(scriptPool[i]) = i + 1 < SCRIPT_POOL_SIZE ? scriptPool[i + 1] : nullptr;
+        }
+        scriptFreeList = scriptPool[0];
+        scriptPoolReady = true;
+    }
+    if (size > SCRIPT_FRAME_SIZE || scriptFreeList == nullptr) return nullptr;
+
+    void* block = scriptFreeList;
+    scriptFreeList = *reinterpret_cast<void**>(block);
+    return block;
+}
+
+void ScriptPoolFree(void* block) {
+    *reinterpret_cast<void**>(block) = scriptFreeList;
+    scriptFreeList = block;
+}
+
+void NextTick::await_suspend(ScriptHandle h) const {
+    h.promise().wakeTime = scriptTime;
+}
+
+void WaitSeconds::await_suspend(ScriptHandle h) const {
+    h.promise().wakeTime = scriptTime + seconds;
+}
+
+// adds a script to the scheduler, it has already run up to its first wait
+void SpawnScript(ScriptTask task) {
+    if (!task.handle) return; //pool was full, the script just doesnt run
+    if (task.handle.done() || scriptCount == SCRIPT_POOL_SIZE) {
+        task.handle.destroy();
+        return;
+    }
+    scripts[scriptCount++] = task.handle;
+}
+
+// resumes every script that is due, then drops the finished ones
+void RunScripts(float frameTime) {
+    scriptTime += frameTime;
+
+    //scripts spawned during this pass already ran once, they wait for the next tick
+    int runCount = scriptCount;
+    for (int i = 0; i < runCount; i++) {
+        if (!scripts[i].done() && scripts[i].promise().wakeTime <= scriptTime) {
+            scripts[i].resume();
+        }
+    }
+
+    int kept = 0;
+    for (int i = 0; i < scriptCount; i++) {
+        if (scripts[i].done()) {
+            scripts[i].destroy();
+        }
+        else {
+            scripts[kept++] = scripts[i];
+        }
+    }
+    scriptCount = kept;
+}
+
+void ResetScripts() {
+    for (int i = 0; i < scriptCount; i++) {
+        scripts[i].destroy();
+    }
+    scriptCount = 0;
+    scriptTime = 0.0f;
+    ufosEntering = 0;
+}
+
+// whole level flow: bring in a wave, wait until it is cleared, fade over to the next one
+ScriptTask LevelScript() {
+    int rows = 2;
+    int cols = 5;
+    StartWave(rows, cols);
+
+    for (;;) {
+        //dying or getting invaded ends the game without us
+        while (currentUfosAlive > 0 || gameStatus != IN_GAME) {
+            co_await NextTick();
+        }
+        gameStatus = LEVEL_UP;
+
+        //fade out
+        float start = scriptTime;
+        levelTransitionTimer = 0.0f;
+        while (levelTransitionTimer < FADE_TIME) {
+            co_await NextTick();
+            levelTransitionTimer = scriptTime - start;
+        }
+
+        //swap the wave while the screen is black, next wave harder as long as it fits on screen
+        rows = KeepInBounds(rows + 1, 1, MAX_WAVE_ROWS);
+        cols = KeepInBounds(cols + 1, 1, MAX_WAVE_COLS);
+        AdvanceLevel();
+        StartWave(rows, cols);
+
+        //hold and fade back in, the new ufos are already flying in
+        while (levelTransitionTimer < TOTAL_TRANSITION_TIME) {
+            co_await NextTick();
+            levelTransitionTimer = scriptTime - start;
+        }
+        levelTransitionTimer = 0.0f;
+        gameStatus = IN_GAME;
+    }
+}
+
+// places a new grid and gives every ufo its own entry script
+void StartWave(int rows, int cols) {
+    //every snapshot has to fit one packet, so network games stop growing the wave there
+    if (netRole != NET_OFFLINE) {
+        while (rows * cols > NET_MAX_WAVE_UFOS) {
+            if (rows > 1) rows--;
+            else cols = NET_MAX_WAVE_UFOS;
+        }
+    }
+    waveNumber++;
+    ufosEntering = 0; //scripts of the last wave stop counting once waveNumber changes
+    SetupUfos(rows, cols);
+    formationOffset = { 0.0f, 0.0f };
+    ufoMoveDirection = 1.0f;
+    formationShape = FORMATION_FLAT;
+    formationLastShape = FORMATION_FLAT;
+    formationChangeTime = scriptTime - FORMATION_BLEND_TIME;
+
+    //spawned first so they run before the ufos each tick, the ufos then follow the moved formation
+    SpawnScript(FormationScript());
+    SpawnScript(UfoFireScript());
+    for (int i = 0; i < ufoCount; i++) {
+        //columns come in one after another, front row first
+        int r = i / cols;
+        int c = i % cols;
+        SpawnScript(UfoScript(i, (c * rows + (rows - 1 - r)) * UFO_ENTRY_STAGGER));
+    }
+}
+
+// marches the wave and changes its shape now and then, ends with the wave
+ScriptTask FormationScript() {
+    int wave = waveNumber;
+    while (wave == waveNumber && ufosEntering > 0) {
+        co_await NextTick(); //formation waits until everyone has arrived
+    }
+
+    float nextChange = scriptTime + FORMATION_CHANGE_TIME;
+    while (wave == waveNumber && currentUfosAlive > 0) {
+        //steps get closer together every level
+        co_await WaitSeconds(BASE_UFO_TIME / static_cast<float>(currentLevel));
+        if (wave != waveNumber || gameStatus != IN_GAME) continue;
+
+        MarchFormation();
+        if (scriptTime >= nextChange) {
+            formationLastShape = formationShape;
+            formationShape = static_cast<FormationShape>((formationShape + 1) % NUM_FORMATIONS);
+            formationChangeTime = scriptTime;
+            nextChange = scriptTime + FORMATION_CHANGE_TIME;
+        }
+    }
+}
+
+// one step of the march, sideways until a wall then down a row
+void MarchFormation() {
+    //calculates speed which increases the level
+    float currentSpeed = UFO_X_SPEED * (0.8f + static_cast<float>(currentLevel) * 0.2f);
+    formationOffset.x += currentSpeed * ufoMoveDirection;
+
+    //the front ufo of each live column is enough, it is the lowest one and all columns share the same x step
+    bool hitWall = false;
+    bool invaded = false;
+    for (int k = 0; k < liveColumnCount; k++) {
+        int c = liveColumns[k];
+        Vector2 front = FormationPosition(columnFrontRow[c], c);
+        if (front.x <= 0 || front.x >= static_cast<float>(SCREEN_WIDTH - UFO_W)) {
+            hitWall = true;
+        }
+        // Check if aliens reached near bottom of screen, if yes end screen will show
+        if (front.y + UFO_H >= static_cast<float>(SCREEN_HEIGHT) - 100) {
+            invaded = true;
+        }
+    }
+    if (invaded) {
+        if (invasionEndsGame) {
+            gameStatus = END_SCREEN;
+        }
+        else {
+            formationOffset.y = 0.0f; //soak godmode, back to the top and keep playing
+        }
+    }
+
+    // If any aliens hits a wall then reverse direction and move down
+    if (hitWall) {
+        ufoMoveDirection *= -1.0f;
+        formationOffset.y += UFO_Y_DROP;
+    }
+}
+
+// how far column c of a cols wide formation sits below its slot in this shape
+float FormationShapeY(FormationShape shape, int c, int cols) {
+    float fromMiddle = fabsf(static_cast<float>(c) - (cols - 1) / 2.0f);
+    switch (shape) {
+    case FORMATION_V:
+        return ((cols - 1) / 2.0f - fromMiddle) * FORMATION_V_STEP;
+    case FORMATION_WAVE:
+        return (sinf(scriptTime * 2.0f + static_cast<float>(c) * 0.8f) + 1.0f) * FORMATION_WAVE_HEIGHT;
+    default:
+        return 0.0f;
+    }
+}
+
+// where the ufo at row r, column c belongs right now, slot plus march plus shape
+Vector2 FormationPosition(int r, int c) {
+    Vector2 slot = UfoSlotPosition(r, c, gridCols);
+    float blend = min(max((scriptTime - formationChangeTime) / FORMATION_BLEND_TIME, 0.0f), 1.0f);
+    blend = blend * blend * (3.0f - 2.0f * blend); //ease in and out
+    float shapeY = FormationShapeY(formationLastShape, c, gridCols) * (1.0f - blend) +
+        FormationShapeY(formationShape, c, gridCols) * blend;
+    return { slot.x + formationOffset.x, slot.y + formationOffset.y + shapeY };
+}
+
+// fires for the wave, faster every level, ends with the wave
+ScriptTask UfoFireScript() {
+    int wave = waveNumber;
+    while (wave == waveNumber && ufosEntering > 0) {
+        co_await NextTick();
+    }
+
+    while (wave == waveNumber && currentUfosAlive > 0) {
+        co_await WaitSeconds(BASE_UFO_FIRE_INTERVAL / (0.5f + static_cast<float>(currentLevel) * 0.5f));
+        if (wave != waveNumber || gameStatus != IN_GAME) continue;
+
+        //only the front ufo of a column shoots, so shots dont go through the formation
+        int col = PickShooterColumn();
+        if (col >= 0) {
+            int shooterIndex = columnFrontRow[col] * gridCols + col;
+            FireShot(allUfos[shooterIndex].hitBox, true, 0.0f);
+        }
+    }
+}
+
+// one ufo for its whole life, flies in from above the screen on a curve then keeps its place in the formation
+ScriptTask UfoScript(int index, float delay) {
+    int wave = waveNumber;
+    int row = index / gridCols;
+    int col = index % gridCols;
+    Vector2 target = { allUfos[index].hitBox.x, allUfos[index].hitBox.y };
+    float side = target.x < SCREEN_WIDTH / 2.0f ? -1.0f : 1.0f; //come in from the nearer edge
+    Vector2 from = { target.x + side * UFO_ENTRY_SWING, target.y - SCREEN_HEIGHT / 2.0f };
+
+    //wait off screen, shots cant reach up there
+    allUfos[index].hitBox.x = from.x;
+    allUfos[index].hitBox.y = from.y;
+    ufosEntering++;
+    co_await WaitSeconds(delay);
+
+    float start = scriptTime;
+    while (wave == waveNumber && allUfos[index].isAlive) {
+        float t = min((scriptTime - start) / UFO_ENTRY_TIME, 1.0f);
+        float ease = 1.0f - (1.0f - t) * (1.0f - t);
+        allUfos[index].hitBox.x = from.x + (target.x - from.x) * ease + sinf(t * PI) * side * UFO_ENTRY_SWING;
+        allUfos[index].hitBox.y = from.y + (target.y - from.y) * ease;
+        if (t >= 1.0f) break;
+        co_await NextTick();
+    }
+    if (wave == waveNumber) ufosEntering--;
+
+    //FormationScript moves the formation, each ufo follows it until it is shot
+    while (wave == waveNumber && allUfos[index].isAlive) {
+        co_await NextTick();
+        if (wave != waveNumber) break; //the arena belongs to the next wave now
+        Vector2 pos = FormationPosition(row, col);
+        allUfos[index].hitBox.x = pos.x;
+        allUfos[index].hitBox.y = pos.y;
+    }
+}
+
+
+//soak test
+// build with SOAK_TEST defined to get a headless binary that plays the game with a bot for
+// millions of ticks and logs memory, allocations, tick times and state checksums to a csv:
+//   space_shooter_soak [-ticks N] [-interval N] [-seed N] [-out soak.csv] [-godmode] [-startlevel N]
+// -godmode keeps the lives topped up and sends invaders back to the top, so a game never ends
+// -startlevel starts every game at level N, with -godmode that reaches the 16 bit and int limits in one run
+// exits with 1 if any row has a flag, warnings are known design limits and only get logged
+#ifdef SOAK_TEST
+
+const float SOAK_TICK_TIME = 1.0f / TARGET_FPS;
+const int SOAK_HIST_BUCKETS = 26;          //tick time histogram, bucket b holds ticks under 2^(b+1) nanoseconds
+const int SOAK_WARMUP_ROWS = 2;            //memory settles during the first rows
+const long long SOAK_RSS_SLACK = 1 << 20;  //rss may wobble this much before it counts as a leak
+const int SOAK_DETERMINISM_TICKS = 20000;  //replayed twice at startup to check the checksums match
+
+long long soakAllocations = 0;
+
+// counts every c++ heap allocation, the game should make none once it is running
+void* operator new(size_t size) {
+    soakAllocations++;
+    void* block = malloc(size ? size : 1);
+    if (!block) throw bad_alloc();
+    return block;
+}
+
+void operator delete(void* block) noexcept {
+    free(block);
+}
+
+void operator delete(void* block, size_t) noexcept {
+    free(block);
+}
+
+// bot state
+int botStateTicks = 0;       //ticks spent in the current game status
+GameStatus botLastStatus = INTRO_MENU;
+int botTargetCol = -1;
+bool botGodMode = false;
+
+// fnv-1a over everything the simulation owns, same seed has to give the same value
+unsigned int StateChecksum() {
+    unsigned int hash = 2166136261u;
+    auto mix = [&hash](int v) { hash = (hash ^ static_cast<unsigned int>(v)) * 16777619u; };
+
+    mix(gameStatus);
+    mix(currentLevel);
+    mix(thePlayer.playerScore);
+    mix(thePlayer.livesLeft);
+    mix(gridRows);
+    mix(gridCols);
+    mix(QuantizePos(thePlayer.hitBox.x));
+    mix(QuantizePos(levelTransitionTimer));
+    for (int i = 0; i < ufoCount; i++) {
+        mix(allUfos[i].isAlive);
+        mix(QuantizePos(allUfos[i].hitBox.x));
+        mix(QuantizePos(allUfos[i].hitBox.y));
+    }
+    for (int i = 0; i < MAX_SHOTS; i++) {
+        mix(allShots[i].isActive);
+        if (allShots[i].isActive) {
+            mix(QuantizePos(allShots[i].hitBox.x));
+            mix(QuantizePos(allShots[i].hitBox.y));
+        }
+    }
+    return hash;
+}
+
+void BotTap(int key) {
+    if (botTappedCount < 4) botTappedKeys[botTappedCount++] = key;
+}
+
+// decides what the bot presses this tick, then the normal state machine reads it
+void BotThink() {
+    botTappedCount = 0;
+    botHoldLeft = false;
+    botHoldRight = false;
+    if (gameStatus != botLastStatus) {
+        botLastStatus = gameStatus;
+        botStateTicks = 0;
+    }
+    botStateTicks++;
+
+    switch (gameStatus) {
+    case INTRO_MENU:
+        //look at the instructions now and then, like a player would
+        if (botStateTicks == 60) BotTap(rand() % 4 == 0 ? KEY_I : KEY_ENTER);
+        break;
+    case HOW_TO_PLAY:
+        if (botStateTicks == 90) BotTap(KEY_ESCAPE);
+        break;
+    case IN_GAME: {
+        if (botGodMode) thePlayer.livesLeft = 3;
+        if (liveColumnCount == 0 || ufosEntering > 0) break;
+
+        //pick a new column to hunt every couple of seconds
+        if (botTargetCol < 0 || botStateTicks % 120 == 0 || columnFrontRow[botTargetCol] < 0) {
+            botTargetCol = liveColumns[rand() % liveColumnCount];
+        }
+        const Rectangle& target = allUfos[columnFrontRow[botTargetCol] * gridCols + botTargetCol].hitBox;
+        float dx = (target.x + target.width / 2) - (thePlayer.hitBox.x + thePlayer.hitBox.width / 2);
+        botHoldLeft = dx < -SHIP_MOVE_SPEED;
+        botHoldRight = dx > SHIP_MOVE_SPEED;
+        if (fabsf(dx) < UFO_W / 2.0f) BotTap(KEY_SPACE);
+        if (rand() % 300 == 0) BotTap(KEY_B);
+        if (rand() % 5000 == 0) BotTap(KEY_P); //take a break sometimes
+        break;
+    }
+    case PAUSED_GAME:
+        if (botStateTicks == 45) BotTap(KEY_P);
+        break;
+    case LEVEL_UP:
+        break;
+    case END_SCREEN:
+        if (botStateTicks == 120) BotTap(KEY_ENTER);
+        break;
+    }
+}
+
+// back to a fresh boot with a fixed seed
+void ResetSoakGame(unsigned int seed) {
+    srand(seed);
+    highScore = 0;
+    gameStatus = INTRO_MENU;
+    InitializeGame();
+    botStateTicks = 0;
+    botLastStatus = INTRO_MENU;
+    botTargetCol = -1;
+}
+
+// one tick of bot + real state machine
+void SoakTick() {
+    BotThink();
+    UpdateGameStatus(SOAK_TICK_TIME);
+}
+
+void SoakAppend(char* list, int size, const char* flag) {
+    if (list[0]) strncat(list, "|", size - strlen(list) - 1);
+    strncat(list, flag, size - strlen(list) - 1);
+}
+
+// appends the reasons this row looks wrong, empty if all is fine, any flag fails the run
+// peakLevel is the highest level seen since the last row, so short lived spikes still count
+// arenaGrewForNothing: the arena went to the heap again without a bigger wave than before asking for it
+void SoakFlags(char* flags, int size, long long rss, long long baselineRss, long long newAllocs, bool arenaGrewForNothing,
+    bool warmedUp, int peakLevel) {
+    flags[0] = '\0';
+    auto add = [&](const char* flag) { SoakAppend(flags, size, flag); };
+
+    if (warmedUp && baselineRss >= 0 && rss > baselineRss + SOAK_RSS_SLACK) add("RSS_GROWTH");
+    if (warmedUp && newAllocs > 0) add("HEAP_ALLOCS");
+    if (arenaGrewForNothing) add("ARENA_GROWTH"); //malloc in ResetLevelArena, operator new doesnt see it
+    if (currentLevel < 1) add("LEVEL_OVERFLOW");
+    if (peakLevel > 65535) add("LEVEL_WIRE_OVERFLOW"); //snapshots send the level as 16 bits
+    if (gridRows < 1 || gridCols < 1 || static_cast<long long>(gridRows) * gridCols != ufoCount) add("GRID_OVERFLOW");
+    if (UfoSlotPosition(0, gridCols - 1, gridCols).x + UFO_W > static_cast<float>(SCREEN_WIDTH)) add("GRID_OFF_SCREEN");
+    if (thePlayer.playerScore < 0 || thePlayer.playerScore > INT_MAX / 2) add("SCORE_OVERFLOW");
+    //float script time stops advancing smoothly once a tick is tiny compared to it
+    if (scriptTime + SOAK_TICK_TIME / 16.0f == scriptTime) add("SCRIPT_TIME_PRECISION");
+    if (!isfinite(levelTransitionTimer) || !isfinite(formationOffset.x) || !isfinite(formationOffset.y) || !isfinite(thePlayer.hitBox.x)) add("NON_FINITE");
+}
+
+// known limits of the design, logged but they dont fail the run
+void SoakWarnings(char* warnings, int size, int peakLevel) {
+    warnings[0] = '\0';
+    //ufos can only step once per tick, past this the level speed up does nothing (normal play reaches it)
+    if (BASE_UFO_TIME / static_cast<float>(peakLevel) < SOAK_TICK_TIME) SoakAppend(warnings, size, "UFO_STEP_BELOW_TICK");
+}
+
+int RunSoak(int argc, char** argv) {
+    long long totalTicks = 5000000;
+    long long interval = 10000;
+    unsigned int seed = 1234;
+    const char* outPath = "soak.csv";
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-ticks") == 0 && i + 1 < argc) totalTicks = atoll(argv[++i]);
+        else if (strcmp(argv[i], "-interval") == 0 && i + 1 < argc) interval = max(1LL, atoll(argv[++i]));
+        else if (strcmp(argv[i], "-seed") == 0 && i + 1 < argc) seed = static_cast<unsigned int>(atoll(argv[++i]));
+        else if (strcmp(argv[i], "-out") == 0 && i + 1 < argc) outPath = argv[++i];
+        else if (strcmp(argv[i], "-godmode") == 0) botGodMode = true;
+        else if (strcmp(argv[i], "-startlevel") == 0 && i + 1 < argc) startLevel = max(1, atoi(argv[++i]));
+    }
+    invasionEndsGame = !botGodMode;
+
+    botInput = true;
+    scoreFileEnabled = false;
+
+    //same seed twice has to give the same checksums
+    unsigned int firstRun = 0;
+    unsigned int secondRun = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        ResetSoakGame(seed);
+        unsigned int combined = 0;
+        for (int t = 0; t < SOAK_DETERMINISM_TICKS; t++) {
+            SoakTick();
+            combined = combined * 31 + StateChecksum();
+        }
+        (pass == 0 ? firstRun : secondRun) = combined;
+    }
+    bool deterministic = firstRun == secondRun;
+    printf("determinism check: %s\n", deterministic ? "ok" : "MISMATCH");
+
+    FILE* csv = fopen(outPath, "w");
+    if (!csv) {
+        printf("could not open %s\n", outPath);
+        return 1;
+    }
+    fprintf(csv, "tick,games,status,level,level_peak,grid_rows,grid_cols,score,rss_bytes,arena_bytes,arena_blocks,allocs_total,"
+        "allocs_new,tick_p50_ns,tick_p99_ns,tick_max_ns,tick_hist,checksum,flags,warnings\n");
+
+    ResetSoakGame(seed);
+    long long histogram[SOAK_HIST_BUCKETS] = {};
+    long long maxTickNs = 0;
+    long long lastAllocs = soakAllocations;
+    long long lastArenaBlocks = levelArena.heapBlocks;
+    size_t lastPeakNeeded = levelArena.peakNeeded;
+    long long baselineRss = -1;
+    long long games = 0;
+    long long flaggedRows = 0;
+    char seenWarnings[256] = "";
+    int rows = 0;
+    int peakLevel = currentLevel;
+    GameStatus previousStatus = gameStatus;
+
+    for (long long tick = 1; tick <= totalTicks; tick++) {
+        auto start = chrono::steady_clock::now();
+        SoakTick();
+        long long ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+
+        int bucket = 0;
+        while (bucket < SOAK_HIST_BUCKETS - 1 && (1LL << (bucket + 1)) <= ns) bucket++;
+        histogram[bucket]++;
+        maxTickNs = max(maxTickNs, ns);
+        peakLevel = max(peakLevel, currentLevel);
+        if (gameStatus == END_SCREEN && previousStatus != END_SCREEN) games++;
+        previousStatus = gameStatus;
+
+        if (tick % interval != 0) continue;
+
+        //percentiles from the histogram, reported as the bucket's upper edge
+        long long seen = 0;
+        long long p50 = -1;
+        long long p99 = -1;
+        char hist[SOAK_HIST_BUCKETS * 12] = "";
+        for (int b = 0; b < SOAK_HIST_BUCKETS; b++) {
+            seen += histogram[b];
+            if (p50 < 0 && seen * 2 >= interval) p50 = 1LL << (b + 1);
+            if (p99 < 0 && seen * 100 >= interval * 99) p99 = 1LL << (b + 1);
+            snprintf(hist + strlen(hist), sizeof(hist) - strlen(hist), b ? ";%lld" : "%lld", histogram[b]);
+        }
+
+        long long rss = CurrentRssBytes();
+        long long newAllocs = soakAllocations - lastAllocs;
+        bool warmedUp = rows >= SOAK_WARMUP_ROWS;
+        if (rows == SOAK_WARMUP_ROWS) baselineRss = rss;
+        bool arenaGrewForNothing = levelArena.heapBlocks > lastArenaBlocks && levelArena.peakNeeded <= lastPeakNeeded;
+        char flags[256];
+        SoakFlags(flags, sizeof(flags), rss, baselineRss, newAllocs, arenaGrewForNothing, warmedUp, peakLevel);
+        if (!deterministic) {
+            strncat(flags, flags[0] ? "|NONDETERMINISTIC" : "NONDETERMINISTIC", sizeof(flags) - strlen(flags) - 1);
+        }
+        if (flags[0]) flaggedRows++;
+        char warnings[256];
+        SoakWarnings(warnings, sizeof(warnings), peakLevel);
+        if (warnings[0] && !strstr(seenWarnings, warnings)) {
+            printf("warning from tick %lld on: %s\n", tick, warnings); //once, the csv has it per row
+            SoakAppend(seenWarnings, sizeof(seenWarnings), warnings);
+        }
+
+        fprintf(csv, "%lld,%lld,%d,%d,%d,%d,%d,%d,%lld,%zu,%d,%lld,%lld,%lld,%lld,%lld,%s,%08x,%s,%s\n",
+            tick, games, gameStatus, currentLevel, peakLevel, gridRows, gridCols, thePlayer.playerScore, rss,
+            levelArena.capacity, levelArena.heapBlocks, soakAllocations, newAllocs, p50, p99, maxTickNs, hist,
+            StateChecksum(), flags, warnings);
+        fflush(csv); //keep what we have if a multi day run gets killed
+
+        for (int b = 0; b < SOAK_HIST_BUCKETS; b++) histogram[b] = 0;
+        maxTickNs = 0;
+        peakLevel = currentLevel;
+        lastAllocs = soakAllocations;
+        lastArenaBlocks = levelArena.heapBlocks;
+        lastPeakNeeded = levelArena.peakNeeded;
+        rows++;
+    }
+    fclose(csv);
+    FreeLevelArena();
+
+    printf("%lld ticks, %lld games, %d rows written to %s, %lld flagged\n", totalTicks, games, rows, outPath, flaggedRows);
+    return (flaggedRows > 0 || !deterministic) ? 1 : 0;
+}
+#endif
@@ -0,0 +1,128 @@
+#include "net_socket.h"
+#include <cstring>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+typedef SOCKET SocketHandle;
+const SocketHandle NO_SOCKET = INVALID_SOCKET;
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <unistd.h>
+typedef int SocketHandle;
+const SocketHandle NO_SOCKET = -1;
+#endif
+
+static SocketHandle netSocket = NO_SOCKET;
+static sockaddr_in peerAddress;
+static sockaddr_in lastSender; //source of the last packet NetSocketReceive returned
+static bool hasPeer = false;
+
+static void CloseSocketHandle(SocketHandle s) {
+#ifdef _WIN32
+    closesocket(s);
+#else
+    close(s);
+#endif
+}
+
+bool NetSocketOpen(unsigned short port) {
+#ifdef _WIN32
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) return false;
+#endif
+    netSocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (netSocket == NO_SOCKET) return false;
+
+    sockaddr_in local;
+    memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    local.sin_port = htons(port);
+    if (bind(netSocket, reinterpret_cast<sockaddr*>(&local), sizeof(local)) != 0) {
+        NetSocketClose();
+        return false;
+    }
+
+    //never block the game loop waiting for packets
+#ifdef _WIN32
+    u_long nonBlocking = 1;
+    ioctlsocket(netSocket, FIONBIO, &nonBlocking);
+#else
+    fcntl(netSocket, F_SETFL, fcntl(netSocket, F_GETFL, 0) | O_NONBLOCK);
+#endif
+    hasPeer = false;
+    return true;
+}
+
+bool NetSocketSetPeer(const char* host, unsigned short port) {
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+
+    addrinfo* result = nullptr;
+    if (getaddrinfo(host, nullptr, &hints, &result) != 0 || result == nullptr) return false;
+
+    memcpy(&peerAddress, result->ai_addr, sizeof(peerAddress));
+    peerAddress.sin_port = htons(port);
+    freeaddrinfo(result);
+    hasPeer = true;
+    return true;
+}
+
+bool NetSocketHasPeer() {
+    return hasPeer;
+}
+
+int NetSocketSend(const void* data, int size) {
+    if (netSocket == NO_SOCKET || !hasPeer) return -1;
+    int sent = static_cast<int>(sendto(netSocket, static_cast<const char*>(data), size, 0,
+        reinterpret_cast<const sockaddr*>(&peerAddress), sizeof(peerAddress)));
+    return sent < 0 ? -1 : sent;
+}
+
+int NetSocketReceive(void* buffer, int maxSize) {
+    if (netSocket == NO_SOCKET) return 0;
+
+    for (;;) {
+        sockaddr_in from;
+        socklen_t fromLen = sizeof(from);
+        int received = static_cast<int>(recvfrom(netSocket, static_cast<char*>(buffer), maxSize, 0,
+            reinterpret_cast<sockaddr*>(&from), &fromLen));
+        if (received <= 0) return 0; //nothing waiting (or an error, treated the same)
+
+        //anyone else on the network could send us inputs or snapshots, skip them
+        if (hasPeer && (from.sin_addr.s_addr != peerAddress.sin_addr.s_addr || from.sin_port != peerAddress.sin_port)) {
+            continue;
+        }
+        lastSender = from;
+        return received;
+    }
+}
+
+void NetSocketAcceptSender() {
+    //the host doesnt know the client address until a valid packet shows up
+    peerAddress = lastSender;
+    hasPeer = true;
+}
+
+void NetSocketClearPeer() {
+    hasPeer = false;
+}
+
+void NetSocketClose() {
+    if (netSocket != NO_SOCKET) {
+        CloseSocketHandle(netSocket);
+        netSocket = NO_SOCKET;
+    }
+    hasPeer = false;
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
@@ -0,0 +1,12 @@
+#pragma once
+// tiny non blocking udp socket used by the two player mode
+// kept in its own file because winsock.h and raylib.h define the same names
+
+bool NetSocketOpen(unsigned short port);                  // bind to port, 0 lets the os pick one
+bool NetSocketSetPeer(const char* host, unsigned short port); // where NetSocketSend sends to
+bool NetSocketHasPeer();
+int NetSocketSend(const void* data, int size);            // bytes sent, -1 on error
+int NetSocketReceive(void* buffer, int maxSize);          // bytes read from the peer (anyone while there is none), 0 if nothing is waiting
+void NetSocketAcceptSender();                             // sender of the last received packet becomes the peer
+void NetSocketClearPeer();                                // forget the peer, the next accepted sender replaces it
+void NetSocketClose();
@@ -0,0 +1,30 @@
+#include "soak_stats.h"
+#include <cstdio>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <unistd.h>
+#endif
+
+long long CurrentRssBytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return -1;
+    return static_cast<long long>(counters.WorkingSetSize);
+#elif defined(__linux__)
+    //second number in statm is the resident size in pages
+    FILE* file = fopen("/proc/self/statm", "r");
+    if (!file) return -1;
+    long long totalPages = 0;
+    long long residentPages = 0;
+    int read = fscanf(file, "%lld %lld", &totalPages, &residentPages);
+    fclose(file);
+    if (read != 2) return -1;
+    return residentPages * sysconf(_SC_PAGESIZE);
+#else
+    return -1;
+#endif
+}
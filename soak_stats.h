@@ -0,0 +1,4 @@
+#pragma once
+// process memory for the soak test, kept apart from raylib.h like net_socket.h
+
+long long CurrentRssBytes(); // resident memory of this process, -1 if the platform isnt supported